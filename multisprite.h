@@ -100,6 +100,17 @@ ramchip char _ms_sbuffer[_MS_DL_MALLOC(-1)];
 #ifdef HORIZONTAL_SCROLLING
 ramchip signed char _ms_hscroll;
 ramchip signed char _ms_delayed_hscroll;
+#ifdef MULTISPRITE_PARALLAX
+#ifndef _MS_PARALLAX_MAX_BANDS
+#define _MS_PARALLAX_MAX_BANDS 4
+#endif
+// Parallax bands: zones [top, bottom[ scrolled at a 8.8 fixed point speed
+ramchip char _ms_parallax_nb_bands;
+ramchip char _ms_parallax_top[_MS_PARALLAX_MAX_BANDS], _ms_parallax_bottom[_MS_PARALLAX_MAX_BANDS];
+ramchip char _ms_parallax_speed_low[_MS_PARALLAX_MAX_BANDS], _ms_parallax_frac[_MS_PARALLAX_MAX_BANDS];
+ramchip signed char _ms_parallax_speed_high[_MS_PARALLAX_MAX_BANDS], _ms_parallax_delta[_MS_PARALLAX_MAX_BANDS];
+ramchip char _ms_delayed_parallax;
+#endif
 #endif
 
 #ifndef _MS_TOP_DISPLAY
@@ -209,6 +220,9 @@ void multisprite_flip();
 #ifdef DMA_CHECK
 ramchip char _ms_dldma[_MS_DLL_ARRAY_SIZE * 2];
 ramchip char _ms_dldma_save[_MS_DLL_ARRAY_SIZE];
+#ifdef MULTISPRITE_OVERLAY
+ramchip char _ms_dldma_save_overlay[_MS_DLL_ARRAY_SIZE * 2]; // Per buffer, like _ms_dlend_save_overlay
+#endif
 #define _MS_DMA_CHECK(x) \
         _ms_dldma[X] -= (x); \
         if (_ms_dldma[X] < 0) { \
@@ -968,6 +982,9 @@ inline void multisprite_start()
  
 #ifdef HORIZONTAL_SCROLLING
     _ms_delayed_hscroll = 0;
+#ifdef MULTISPRITE_PARALLAX
+    _ms_delayed_parallax = 0;
+#endif
 #endif
 
     _ms_buffer = 0; // 0 is the current write buffer
@@ -1081,6 +1098,9 @@ INIT_BANK void multisprite_clear()
 #endif
 #ifdef MULTISPRITE_OVERLAY
         _ms_dlend_save_overlay[X] = 0;
+#ifdef DMA_CHECK
+        _ms_dldma_save_overlay[X] = _MS_DMA_START_VALUE;
+#endif
 #endif
     }
     for (X = _MS_DLL_ARRAY_SIZE - 1; X >= 0; X--) {
@@ -1113,6 +1133,10 @@ void multisprite_save()
 #endif
 #ifdef DMA_CHECK
             _ms_dldma_save[X] = _ms_dldma[Y];
+#ifdef MULTISPRITE_OVERLAY
+            _ms_dldma_save_overlay[Y] = _ms_dldma[Y];
+            _ms_dldma_save_overlay[X] = _ms_dldma[Y];
+#endif
 #endif
         }
         // Copy the DLs from current write buffer to all buffers
@@ -1134,6 +1158,10 @@ void multisprite_save()
         for (Y = _MS_DLL_ARRAY_SIZE * 2 - 1, X = _MS_DLL_ARRAY_SIZE - 1; X >= 0; Y--, X--) {
             _ms_dlend_save_overlay[Y] = _ms_dlend[X];
             _ms_dlend_save_overlay[X] = _ms_dlend[X];
+#ifdef DMA_CHECK
+            _ms_dldma_save_overlay[Y] = _ms_dldma[X];
+            _ms_dldma_save_overlay[X] = _ms_dldma[X];
+#endif
         }
 #endif
         // Copy the DLs from current write buffer to all buffers
@@ -1153,10 +1181,16 @@ void multisprite_save_overlay()
     if (_ms_buffer) {
         for (Y = _MS_DLL_ARRAY_SIZE * 2 - 1, X = _MS_DLL_ARRAY_SIZE - 1; X >= 0; Y--, X--) {
             _ms_dlend_save_overlay[Y] = _ms_dlend[Y];
+#ifdef DMA_CHECK
+            _ms_dldma_save_overlay[Y] = _ms_dldma[Y];
+#endif
         }
     } else {
         for (X = _MS_DLL_ARRAY_SIZE - 1; X >= 0; X--) {
             _ms_dlend_save_overlay[X] = _ms_dlend[X];
+#ifdef DMA_CHECK
+            _ms_dldma_save_overlay[X] = _ms_dldma[X];
+#endif
         }
     }
 }
@@ -1167,11 +1201,19 @@ void multisprite_clear_overlay()
         for (Y = _MS_DLL_ARRAY_SIZE * 2 - 1, X = _MS_DLL_ARRAY_SIZE - 1; X >= 0; Y--, X--) {
             _ms_dlend_save_overlay[Y] = _ms_dlend_save[X];
             _ms_dlend[Y] = _ms_dlend_save[X];
+#ifdef DMA_CHECK
+            _ms_dldma_save_overlay[Y] = _ms_dldma_save[X];
+            _ms_dldma[Y] = _ms_dldma_save[X];
+#endif
         }
     } else {
         for (X = _MS_DLL_ARRAY_SIZE - 1; X >= 0; X--) {
             _ms_dlend_save_overlay[X] = _ms_dlend_save[X];
             _ms_dlend[X] = _ms_dlend_save[X];
+#ifdef DMA_CHECK
+            _ms_dldma_save_overlay[X] = _ms_dldma_save[X];
+            _ms_dldma[X] = _ms_dldma_save[X];
+#endif
         }
     }
 }
@@ -1543,6 +1585,16 @@ void _ms_move_save_down()
     _ms_sbuffer_size = 0;
     _ms_sbuffer_dma = _MS_DMA_START_VALUE;
 #endif
+#ifdef MULTISPRITE_OVERLAY
+    // The entering zone is the same in both buffers
+    _ms_dlend_save_overlay[X] = _ms_dlend_save[X];
+    Y = X + _MS_DLL_ARRAY_SIZE;
+    _ms_dlend_save_overlay[Y] = _ms_dlend_save[X];
+#ifdef DMA_CHECK
+    _ms_dldma_save_overlay[X] = _ms_dldma_save[X];
+    _ms_dldma_save_overlay[Y] = _ms_dldma_save[X];
+#endif
+#endif
 }
 
 void _ms_move_dlls_up()
@@ -1620,11 +1672,22 @@ void _ms_move_save_up()
     _ms_sbuffer_size = 0;
     _ms_sbuffer_dma = _MS_DMA_START_VALUE;
 #endif
+#ifdef MULTISPRITE_OVERLAY
+    // The entering zone is the same in both buffers
+    _ms_dlend_save_overlay[X] = _ms_dlend_save[X];
+    Y = X + _MS_DLL_ARRAY_SIZE;
+    _ms_dlend_save_overlay[Y] = _ms_dlend_save[X];
+#ifdef DMA_CHECK
+    _ms_dldma_save_overlay[X] = _ms_dldma_save[X];
+    _ms_dldma_save_overlay[Y] = _ms_dldma_save[X];
+#endif
+#endif
 }
 #endif
 
 void _ms_vertical_scrolling_adjust_bottom_of_screen();
 void _ms_horizontal_scrolling_visible();
+void _ms_parallax_apply();
 
 // This one should obvisouly executed during VBLANK, since it modifies the DPPL/H pointers
 void multisprite_flip()
@@ -1651,6 +1714,12 @@ void multisprite_flip()
             _ms_horizontal_scrolling_visible();
             _ms_delayed_hscroll = 0;
         }
+#ifdef MULTISPRITE_PARALLAX
+        if (_ms_delayed_parallax) {
+            _ms_parallax_apply();
+            _ms_delayed_parallax = 0;
+        }
+#endif
 #endif
 #ifdef VERTICAL_SCROLLING
         if (_ms_delayed_vscroll) {
@@ -1669,11 +1738,14 @@ void multisprite_flip()
         for (X = _MS_DLL_ARRAY_SIZE - 1; X >= 0; X--) {
 #ifdef MULTISPRITE_OVERLAY
             _ms_dlend[X] = _ms_dlend_save_overlay[X];
+#ifdef DMA_CHECK
+            _ms_dldma[X] = _ms_dldma_save_overlay[X];
+#endif
 #else
             _ms_dlend[X] = _ms_dlend_save[X];
-#endif
 #ifdef DMA_CHECK
             _ms_dldma[X] = _ms_dldma_save[X];
+#endif
 #endif
         }
     } else {
@@ -1698,6 +1770,12 @@ void multisprite_flip()
             _ms_horizontal_scrolling_visible();
             _ms_delayed_hscroll = 0;
         }
+#ifdef MULTISPRITE_PARALLAX
+        if (_ms_delayed_parallax) {
+            _ms_parallax_apply();
+            _ms_delayed_parallax = 0;
+        }
+#endif
 #endif
 #ifdef VERTICAL_SCROLLING
         if (_ms_delayed_vscroll) {
@@ -1716,11 +1794,14 @@ void multisprite_flip()
         for (Y = _MS_DLL_ARRAY_SIZE * 2 - 1, X = _MS_DLL_ARRAY_SIZE - 1; X >= 0; Y--, X--) {
 #ifdef MULTISPRITE_OVERLAY
             _ms_dlend[Y] = _ms_dlend_save_overlay[Y];
+#ifdef DMA_CHECK
+            _ms_dldma[Y] = _ms_dldma_save_overlay[Y];
+#endif
 #else
             _ms_dlend[Y] = _ms_dlend_save[X];
-#endif
 #ifdef DMA_CHECK
             _ms_dldma[Y] = _ms_dldma_save[X];
+#endif
 #endif
         }
     }
@@ -1921,6 +2002,56 @@ void _ms_horizontal_scrolling()
 #endif
 }
 
+#ifdef MULTISPRITE_PARALLAX
+#define multisprite_parallax_init() _ms_parallax_nb_bands = 0; _ms_delayed_parallax = 0
+
+// Adds a band made of zones [top, bottom[. speed is 8.8 fixed point (0x0180 = 1.5 pixel per frame)
+// speed must stay in the [-7.0, 7.0[ range (high byte in [-7, 6]): with the carry from the fractional part,
+// the per frame offset is then in [-7, 7], as required by _ms_horizontal_tiles_scrolling
+#define multisprite_parallax_band(top, bottom, speed) \
+    X = _ms_parallax_nb_bands++; \
+    _ms_parallax_top[X] = (top); \
+    _ms_parallax_bottom[X] = (bottom); \
+    _ms_parallax_speed_low[X] = (speed); \
+    _ms_parallax_speed_high[X] = (speed) >> 8; \
+    _ms_parallax_frac[X] = 0; \
+    _ms_parallax_delta[X] = 0;
+
+#define multisprite_parallax_set_speed(band, speed) \
+    X = (band); \
+    _ms_parallax_speed_low[X] = (speed); \
+    _ms_parallax_speed_high[X] = (speed) >> 8;
+
+// Applies the pending integer offsets to the current write buffer. Bands that didn't move are left untouched
+void _ms_parallax_apply()
+{
+    for (_ms_tmp3 = _ms_parallax_nb_bands - 1; _ms_tmp3 >= 0; _ms_tmp3--) {
+        X = _ms_tmp3;
+        if (_ms_parallax_delta[X]) {
+            _ms_tmp4 = _ms_parallax_bottom[X];
+            for (_ms_tmp2 = _ms_parallax_top[X]; _ms_tmp2 != _ms_tmp4; _ms_tmp2++) {
+                X = _ms_tmp3;
+                multisprite_horizontal_tiles_scrolling(0, _ms_tmp2, _ms_parallax_delta[X]);
+            }
+        }
+    }
+}
+
+// To be called once per frame, before multisprite_flip(). The same offsets are applied to the other buffer at flip time
+void multisprite_parallax_scrolling()
+{
+    _ms_delayed_parallax = 0;
+    for (X = _ms_parallax_nb_bands - 1; X >= 0; X--) {
+        _ms_tmp = _ms_parallax_frac[X];
+        _ms_parallax_frac[X] += _ms_parallax_speed_low[X];
+        _ms_parallax_delta[X] = _ms_parallax_speed_high[X];
+        if (_ms_parallax_frac[X] < _ms_tmp) _ms_parallax_delta[X]++; // Carry from the fractional part
+        if (_ms_parallax_delta[X]) _ms_delayed_parallax = 1;
+    }
+    if (_ms_delayed_parallax) _ms_parallax_apply();
+}
+#endif
+
 #endif
 
 #define _ms_width_palette(width, palette) (((-(width)) & 0x1f) | ((palette) << 5))
@@ -1953,6 +2084,87 @@ void _multisprite_disable_dli()
     _ms_b1_dll[X] &= 0x7f;
 }
 
+#ifdef MULTISPRITE_CHARBASE_ANIMATION
+// Tile animation by CHARBASE swapping: the frames of an animated charset are stored stride pages apart, so that
+// all the tiles using it are animated with one register write, without touching the DLs. Animation 0 is used for
+// the whole screen, unless multisprite_charbase_animation_zones is called: each zone then gets its own animation,
+// CHARBASE being set by a DLI at the end of the previous zone (call multisprite_charbase_animation_dli from the DLI handler)
+#define _MS_NB_ANIMATIONS 4
+ramchip char _ms_anim_base[_MS_NB_ANIMATIONS], _ms_anim_stride[_MS_NB_ANIMATIONS], _ms_anim_frames[_MS_NB_ANIMATIONS], _ms_anim_period[_MS_NB_ANIMATIONS];
+ramchip char _ms_anim_frame[_MS_NB_ANIMATIONS], _ms_anim_counter[_MS_NB_ANIMATIONS], _ms_anim_charbase[_MS_NB_ANIMATIONS];
+ramchip char _ms_zone_anim[_MS_DLL_ARRAY_SIZE];
+ramchip char _ms_anim_zones, _ms_anim_dli_zone;
+
+// period: number of frames per animation step
+#define multisprite_charbase_animation(anim, charset, stride, nb_frames, period) \
+    X = (anim); \
+    _ms_anim_base[X] = (charset) >> 8; \
+    _ms_anim_charbase[X] = (charset) >> 8; \
+    _ms_anim_stride[X] = (stride); \
+    _ms_anim_frames[X] = (nb_frames); \
+    _ms_anim_period[X] = (period); \
+    _ms_anim_counter[X] = (period); \
+    _ms_anim_frame[X] = 0;
+
+#define multisprite_charbase_animation_zone(zone, anim) _ms_zone_anim[X = (zone)] = (anim)
+
+// Zone by zone animation. Zones use animation 0 until set by multisprite_charbase_animation_zone
+#define multisprite_charbase_animation_dli() \
+    X = _ms_anim_dli_zone; \
+    _ms_anim_dli_zone++; \
+    X = _ms_zone_anim[X]; \
+    Y = _ms_anim_charbase[X]; \
+    strobe(WSYNC); \
+    *CHARBASE = Y;
+
+void multisprite_charbase_animation_init()
+{
+    for (X = _MS_NB_ANIMATIONS - 1; X >= 0; X--) {
+        _ms_anim_frames[X] = 0;
+    }
+    for (X = _MS_DLL_ARRAY_SIZE - 1; X >= 0; X--) {
+        _ms_zone_anim[X] = 0;
+    }
+    _ms_anim_zones = 0;
+}
+
+void multisprite_charbase_animation_zones()
+{
+    char zone;
+    for (zone = 0; zone != _MS_DLL_ARRAY_SIZE - 1; zone++) {
+        multisprite_enable_dli(zone);
+    }
+    _ms_anim_zones = 1;
+}
+
+// To be called once per frame, during VBLANK (right after multisprite_flip)
+void multisprite_charbase_animation_update()
+{
+    for (X = _MS_NB_ANIMATIONS - 1; X >= 0; X--) {
+        if (_ms_anim_frames[X]) {
+            _ms_anim_counter[X]--;
+            if (!_ms_anim_counter[X]) {
+                _ms_anim_counter[X] = _ms_anim_period[X];
+                _ms_anim_frame[X]++;
+                if (_ms_anim_frame[X] == _ms_anim_frames[X]) {
+                    _ms_anim_frame[X] = 0;
+                    _ms_anim_charbase[X] = _ms_anim_base[X];
+                } else {
+                    _ms_anim_charbase[X] += _ms_anim_stride[X];
+                }
+            }
+        }
+    }
+    if (_ms_anim_zones) {
+        X = _ms_zone_anim[0];
+        _ms_anim_dli_zone = 1;
+    } else {
+        X = 0;
+    }
+    *CHARBASE = _ms_anim_charbase[X];
+}
+#endif
+
 const char _ms_bit_extract[8] = {128, 64, 32, 16, 8, 4, 2, 1};
 
 // ~100 cycles max pixel accurate collision detection (60us)
@@ -2014,6 +2226,267 @@ const char _ms_bit_extract[8] = {128, 64, 32, 16, 8, 4, 2, 1};
 
 #define multisprite_collision_detected (_ms_tmp3)
 
+// Runtime pixel accurate collision, with a 1 bit mask per sprite instead of a collision map per pair of sprites.
+// Masks are 2 bytes per row (up to 16 pixels wide, bit 7 of the first byte is the leftmost pixel), one row per line.
+// m1 is the mask of the leftmost sprite, and s the horizontal distance between the sprites, in mask pixels
+char _ms_mask_collision(char *m1, char y1, char h1, char *m2, char y2, char h2, char s)
+{
+    char n, i, hi, lo;
+    // Align the overlapping rows
+    if (y2 >= y1) {
+        m1 += (y2 - y1) << 1;
+        n = y1 + h1 - y2;
+        if (n > h2) n = h2;
+    } else {
+        m2 += (y1 - y2) << 1;
+        n = y2 + h2 - y1;
+        if (n > h1) n = h1;
+    }
+    for (Y = 0; n != 0; n--) {
+        hi = m2[Y];
+        lo = m2[++Y];
+        // Shift the right mask to the position of the left one
+        for (i = s; i != 0; i--) {
+            lo >>= 1;
+            if (hi & 1) lo |= 0x80;
+            hi >>= 1;
+        }
+        if (lo & m1[Y]) return 1;
+        Y--;
+        if (hi & m1[Y]) return 1;
+        Y += 2;
+    }
+    return 0;
+}
+
+// Mask collision (x1, x2 and widths in 160 pixels resolution). The box test filters out the common miss case
+#define multisprite_compute_mask_collision(x1, y1, w1, h1, mask1, x2, y2, w2, h2, mask2) {\
+    multisprite_compute_box_collision(x1, y1, w1, h1, x2, y2, w2, h2); \
+    if (_ms_tmp3) { \
+        if ((x1) <= (x2)) { \
+            _ms_tmp3 = _ms_mask_collision(mask1, y1, h1, mask2, y2, h2, (x2) - (x1)); \
+        } else { \
+            _ms_tmp3 = _ms_mask_collision(mask2, y2, h2, mask1, y1, h1, (x1) - (x2)); \
+        } \
+    } \
+}
+
+// 320 pixels resolution mask collision function
+// x1 and x2 are 160 pixels resolution (always)
+// w1, w2 and the masks are 320 pixels resolution
+#define multisprite_compute_mask_collision_320(x1, y1, w1, h1, mask1, x2, y2, w2, h2, mask2) {\
+    multisprite_compute_box_collision(x1, y1, ((w1) >> 1), h1, x2, y2, ((w2) >> 1), h2); \
+    if (_ms_tmp3) { \
+        if ((x1) <= (x2)) { \
+            _ms_tmp3 = _ms_mask_collision(mask1, y1, h1, mask2, y2, h2, ((x2) - (x1)) << 1); \
+        } else { \
+            _ms_tmp3 = _ms_mask_collision(mask2, y2, h2, mask1, y1, h1, ((x1) - (x2)) << 1); \
+        } \
+    } \
+}
+
+#ifdef MULTISPRITE_BROADPHASE
+// Zone bucketed broadphase for sprite vs sprite collisions (e.g. bullets vs enemies). Objects of 2 groups are
+// inserted each frame, usually next to their display, into the bucket of the zone of their top line, computed
+// as multisprite_display_sprite does (with the vertical scrolling offsets). Only pairs of objects in the same or
+// adjacent zones (modulo 16, like the DLL) are tested. Objects higher than 16 pixels would miss the zones below,
+// so they go to a separate list tested against all the objects of the other group (keep them few).
+// Like the sprites, objects with y >= 240 are above the top of the screen (y - 256)
+#ifndef MULTISPRITE_BROADPHASE_SIZE
+#define MULTISPRITE_BROADPHASE_SIZE 32
+#endif
+#ifndef MULTISPRITE_BROADPHASE_MAX_HITS
+#define MULTISPRITE_BROADPHASE_MAX_HITS 8
+#endif
+ramchip char _ms_bp_x[MULTISPRITE_BROADPHASE_SIZE], _ms_bp_y[MULTISPRITE_BROADPHASE_SIZE], _ms_bp_w[MULTISPRITE_BROADPHASE_SIZE], _ms_bp_h[MULTISPRITE_BROADPHASE_SIZE];
+ramchip char _ms_bp_id[MULTISPRITE_BROADPHASE_SIZE], _ms_bp_next[MULTISPRITE_BROADPHASE_SIZE];
+ramchip char _ms_bp_head_a[_MS_DLL_ARRAY_SIZE], _ms_bp_head_b[_MS_DLL_ARRAY_SIZE];
+ramchip char _ms_bp_tall_a, _ms_bp_tall_b;
+ramchip char _ms_bp_nb;
+// Colliding pairs found by multisprite_broadphase_collide (ids given at insertion)
+ramchip char multisprite_hit_a[MULTISPRITE_BROADPHASE_MAX_HITS], multisprite_hit_b[MULTISPRITE_BROADPHASE_MAX_HITS];
+
+// To be called at the beginning of each frame
+void multisprite_broadphase_clear()
+{
+    for (X = _MS_DLL_ARRAY_SIZE - 1; X >= 0; X--) {
+        _ms_bp_head_a[X] = 0xff;
+        _ms_bp_head_b[X] = 0xff;
+    }
+    _ms_bp_tall_a = 0xff;
+    _ms_bp_tall_b = 0xff;
+    _ms_bp_nb = 0;
+}
+
+#define multisprite_broadphase_add_a(id, x, y, w, h) _ms_bp_add(0, id, x, y, w, h)
+#define multisprite_broadphase_add_b(id, x, y, w, h) _ms_bp_add(1, id, x, y, w, h)
+
+// Stores the object and links it in front of the bucket of its zone (or of the tall objects list)
+void _ms_bp_add(char group, char id, char x, char y, char w, char h)
+{
+    char zone;
+    if (_ms_bp_nb == MULTISPRITE_BROADPHASE_SIZE) {
+        _ms_dmaerror++;
+        return;
+    }
+#ifdef VERTICAL_SCROLLING
+    _ms_tmp2 = y + _ms_vscroll_fine_offset;
+    X = _ms_shift3[Y = ((_ms_tmp2 >> 1) + _ms_vscroll_coarse_offset_shifted) & 0xfe];
+#else
+    X = _ms_shift4[Y = y & 0xfe];
+#endif
+    zone = X;
+    X = _ms_bp_nb;
+    _ms_bp_nb++;
+    _ms_bp_id[X] = id;
+    _ms_bp_x[X] = x;
+    _ms_bp_y[X] = y + 16; // [-16, 240[ to [0, 256[, so that the box tests don't wrap above the top of the screen
+    _ms_bp_w[X] = w;
+    _ms_tmp = _ms_bp_y[X] + h;
+    if (_ms_tmp < _ms_bp_y[X]) h = -_ms_bp_y[X]; // Nor below the bottom
+    _ms_bp_h[X] = h;
+    if (h > 16) {
+        if (group) {
+            _ms_bp_next[X] = _ms_bp_tall_b;
+            _ms_bp_tall_b = X;
+        } else {
+            _ms_bp_next[X] = _ms_bp_tall_a;
+            _ms_bp_tall_a = X;
+        }
+        return;
+    }
+    Y = zone;
+    if (group) {
+        _ms_bp_next[X] = _ms_bp_head_b[Y];
+        _ms_bp_head_b[Y] = X;
+    } else {
+        _ms_bp_next[X] = _ms_bp_head_a[Y];
+        _ms_bp_head_a[Y] = X;
+    }
+}
+
+// Tests the object a against the list of objects of group b starting at b. The colliding pairs are stored
+// from index nb, and the new number of pairs is returned
+char _ms_bp_test(char a, char b, char nb)
+{
+    char ax, ay, aw, ah;
+    X = a;
+    ax = _ms_bp_x[X];
+    ay = _ms_bp_y[X];
+    aw = _ms_bp_w[X];
+    ah = _ms_bp_h[X];
+    while (b != 0xff) {
+        X = b;
+        multisprite_compute_box_collision(ax, ay, aw, ah, _ms_bp_x[X], _ms_bp_y[X], _ms_bp_w[X], _ms_bp_h[X]);
+        if (_ms_tmp3) {
+            if (nb == MULTISPRITE_BROADPHASE_MAX_HITS) return nb;
+            Y = nb;
+            multisprite_hit_b[Y] = _ms_bp_id[X];
+            multisprite_hit_a[Y] = _ms_bp_id[X = a];
+            nb++;
+        }
+        b = _ms_bp_next[X = b];
+    }
+    return nb;
+}
+
+// Tests the objects of group a against the objects of group b of the same and adjacent zones, and against
+// the tall objects. Returns the number of colliding pairs, stored in multisprite_hit_a and multisprite_hit_b
+char multisprite_broadphase_collide()
+{
+    char z, zz, k, a, nb = 0;
+    for (z = 0; z != _MS_DLL_ARRAY_SIZE; z++) {
+        for (a = _ms_bp_head_a[X = z]; a != 0xff; a = _ms_bp_next[X = a]) {
+            zz = (z - 1) & (_MS_DLL_ARRAY_SIZE - 1);
+            for (k = 3; k != 0; k--, zz = (zz + 1) & (_MS_DLL_ARRAY_SIZE - 1)) {
+                nb = _ms_bp_test(a, _ms_bp_head_b[X = zz], nb);
+            }
+            nb = _ms_bp_test(a, _ms_bp_tall_b, nb);
+        }
+    }
+    // Tall objects of group a: against every zone
+    for (a = _ms_bp_tall_a; a != 0xff; a = _ms_bp_next[X = a]) {
+        for (z = 0; z != _MS_DLL_ARRAY_SIZE; z++) {
+            nb = _ms_bp_test(a, _ms_bp_head_b[X = z], nb);
+        }
+        nb = _ms_bp_test(a, _ms_bp_tall_b, nb);
+    }
+    return nb;
+}
+#endif
+
+// Per-tile collision masks, for pixel accurate collisions with the background (slopes, rounded platforms...):
+// 16 rows of 8 pixels per tile (bit 7 is the leftmost pixel), stored as 16 planes of nb_tiles bytes
+// (row r of tile t is masks[r * nb_tiles + t]). Masks are indexed by tile number t, while the maps and tilesets hold
+// character codes: 2 * t with the 2 bytes wide characters, plus 1 for the vertically mirrored tiles of the video
+// memory tilesets. The tests take character codes. Tiles >= nb_tiles are empty
+ramchip char *_ms_tile_masks;
+ramchip char _ms_tile_masks_nb;
+
+#define multisprite_tile_masks(masks, nb_tiles) \
+    _ms_tile_masks = (masks); \
+    _ms_tile_masks_nb = (nb_tiles);
+
+// Pixels [l, 7] and [0, r] of a mask row
+const char _ms_mask_left[8] = {0xff, 0x7f, 0x3f, 0x1f, 0x0f, 0x07, 0x03, 0x01};
+const char _ms_mask_right[8] = {0x80, 0xc0, 0xe0, 0xf0, 0xf8, 0xfc, 0xfe, 0xff};
+
+// Builds the masks of nb_tiles tiles into dst (16 * nb_tiles bytes) from their 160A graphics, declared
+// scattered(16, 2) (the 7800 reads the bottom row first: row r of tile t, character code 2 * t, is gfx[(15 - r) * 256 + 2 * t]).
+// A pixel is solid if its color is not 0
+void multisprite_build_tile_masks(char *gfx, char nb_tiles, char *dst)
+{
+    char r, t, b, m, i;
+    multisprite_tile_masks(dst, nb_tiles);
+    gfx += 15 * 256;
+    for (r = 0; r != 16; r++) {
+        for (t = 0; t != nb_tiles; t++) {
+            m = 0;
+            Y = t << 1;
+            b = gfx[Y];
+            for (i = 4; i != 0; i--) {
+                m <<= 1;
+                if (b & 0xc0) m |= 1;
+                b <<= 2;
+            }
+            b = gfx[++Y];
+            for (i = 4; i != 0; i--) {
+                m <<= 1;
+                if (b & 0xc0) m |= 1;
+                b <<= 2;
+            }
+            dst[Y = t] = m;
+        }
+        gfx -= 256;
+        dst += nb_tiles;
+    }
+}
+
+// Tests the rows [top, bottom] of the mask of the tile (a character code) against the pixels given by bits
+// (returns 0 if no collision)
+char _ms_tile_mask_test(char tile, char top, char bottom, char bits)
+{
+    char *ptr, t;
+    if (tile & 1) { // Vertically mirrored: row r shows row 15 - r of the tile
+        t = top;
+        top = 15 - bottom;
+        bottom = 15 - t;
+    }
+    tile >>= 1;
+    if (tile >= _ms_tile_masks_nb) return 0;
+    ptr = _ms_tile_masks + tile;
+    for (X = top; X != 0; X--) ptr += _ms_tile_masks_nb;
+    for (X = bottom - top; X >= 0; X--) {
+        if (ptr[Y = 0] & bits) return 1;
+        ptr += _ms_tile_masks_nb;
+    }
+    return 0;
+}
+
+// Tests the pixels [left, right] x [top, bottom] of the tile (character code, coordinates inside the 8x16 tile)
+#define _ms_tile_mask_box(tile, left, top, right, bottom) \
+    _ms_tile_mask_test(tile, top, bottom, _ms_mask_left[X = (left)] & _ms_mask_right[Y = (right)])
+
 #define multisprite_sparse_tiling(ptr, line, top, left, height) \
     _ms_sparse_tiles_ptr_high = ptr[Y = 0]; \
     _ms_sparse_tiles_ptr_low = ptr[Y = 1]; \
@@ -2064,13 +2537,118 @@ void _ms_sparse_tiling(char line, char top, char left, char height)
     }
 }
 
+#ifdef SPARSE_TILING_TEMPLATES
+// Precompiled sparse tiling lines (generated offline from the sparse tilesets). Each line is stored as:
+//    Size of the DL entries (in bytes)
+//    DMA cost of the whole line
+//    Ready-made 4 or 5 bytes DL entries, with X = 8 * tileset start column
+char *_ms_sparse_templates_ptr_high, *_ms_sparse_templates_ptr_low;
+
+#define multisprite_sparse_tiling_template(ptr, line, top, left, height) \
+    _ms_sparse_templates_ptr_high = ptr[Y = 0]; \
+    _ms_sparse_templates_ptr_low = ptr[Y = 1]; \
+    _ms_sparse_tiling_template(line, top, left, height);
+
+// Adds offset to the X byte of all the DL entries of _ms_tmpptr[0..size[
+void _ms_sparse_template_offset(char size, char offset)
+{
+    for (Y = 0; Y < size; Y++) {
+        if ((_ms_tmpptr[++Y] & 0x1f) == 0) {
+            // This is an extended header
+            Y++;
+        }
+        Y++; Y++;
+        _ms_tmpptr[Y] += offset;
+    }
+}
+
+// Appends the template of the given line to the display list of zone X, moved by offset pixels
+void _ms_sparse_template_line(char line, char offset)
+{
+    char *ptr, size;
+    Y = line;
+    ptr = _ms_sparse_templates_ptr_low[Y] | (_ms_sparse_templates_ptr_high[Y] << 8);
+    size = ptr[Y = 0];
+#ifdef DMA_CHECK
+    _ms_dldma[X] -= ptr[++Y];
+#endif
+    ptr += 2;
+    _ms_tmpptr = _ms_dls[X] + _ms_dlend[X];
+    Y = size;
+    if (Y) {
+        do {
+            Y--;
+            _ms_tmpptr[Y] = ptr[Y];
+        } while (Y);
+        if (offset) _ms_sparse_template_offset(size, offset);
+        _ms_dlend[X] += size;
+    }
+}
+
+// Sparse tiling simple display, from precompiled templates: a block copy and an X offset add per line
+void _ms_sparse_tiling_template(char line, char top, char left, char height)
+{
+    char bottom;
+    _ms_tmp2 = line;
+
+    bottom = top + height;
+    if (_ms_buffer) {
+        top += _MS_DLL_ARRAY_SIZE;
+        bottom += _MS_DLL_ARRAY_SIZE;
+    }
+
+    for (X = top; X < bottom; _ms_tmp2++) {
+        _ms_sparse_template_line(_ms_tmp2, left);
+        X++;
+    }
+}
+#endif
+
+#ifdef SPARSE_TILING_COLUMN_INDEX
+// Coarse column index of the sparse lines, for constant time collision lookups. For each line, 32 bytes:
+// entry i is the offset of the first tileset ending at or after column 8 * i (or of the end of line marker).
+// The index can be generated offline in ROM, or built into RAM with multisprite_sparse_tiling_build_index
+char *_ms_sparse_index_ptr_high, *_ms_sparse_index_ptr_low;
+
+#define multisprite_sparse_tiling_index(ptr) \
+    _ms_sparse_index_ptr_high = ptr[Y = 0]; \
+    _ms_sparse_index_ptr_low = ptr[Y = 1];
+
+// Builds the column index of the given sparse line into dst (32 bytes)
+void multisprite_sparse_tiling_build_index(char line, char *dst)
+{
+    char *ptr, i, c = 0, offset = 0;
+    Y = line;
+    ptr = _ms_sparse_tiles_ptr_low[Y] | (_ms_sparse_tiles_ptr_high[Y] << 8);
+    for (i = 0; i != 32; c += 8, i++) {
+        Y = offset;
+        do {
+            if (ptr[++Y] == 0xff) { // End of line
+                Y--;
+                break;
+            }
+            Y--;
+            if (ptr[Y] >= c) break;
+            Y += 7;
+        } while (1);
+        offset = Y;
+        dst[Y = i] = offset;
+    }
+}
+#endif
+
 char multisprite_sparse_tiling_collision(char top, char left, char right)
 {
     char *ptr, start, end, intersect = -1;
     Y = top;
     ptr = _ms_sparse_tiles_ptr_low[Y] | (_ms_sparse_tiles_ptr_high[Y] << 8);
     // Find the first possibly intersecting tileset on this line
+#ifdef SPARSE_TILING_COLUMN_INDEX
+    char *idx = _ms_sparse_index_ptr_low[Y] | (_ms_sparse_index_ptr_high[Y] << 8);
+    Y = idx[Y = left >> 3]; // At most a few tilesets left to skip
+#else
     Y = 0;
+#endif
     while (ptr[Y] < left) Y += 7;
     // This one possibly intersects
     end = ptr[Y++];
@@ -17,6 +17,11 @@
 //    High address
 //    Palette & Width
 //    DMA cost
+// With SPARSE_TILING_SOA (horizontal scrolling), a line is stored as a structure of arrays instead, indexed by
+// tileset number, so that a line can hold up to 255 tilesets (the 7 bytes records are limited to 36 by the Y register):
+//    Number of tilesets n
+//    n X end of tileset, n X beginning of tileset, n Low addresses, n Mode bytes, n High addresses, n Palette & Width, n DMA costs
+// (no 96, 0xff terminator)
 
 #ifdef HORIZONTAL_SCROLLING
 #define MULTISPRITE_OVERLAY
@@ -27,15 +32,175 @@
 #endif
 
 #define SPARSE_TILING_SCROLLING_ZONE (14 - _MS_BOTTOM_SCROLLING_ZONE)
-ramchip char *_tiling_ptr[SPARSE_TILING_SCROLLING_ZONE];
-ramchip signed char _tiling_xpos[2 * SPARSE_TILING_SCROLLING_ZONE], _tiling_xoffset[2 * SPARSE_TILING_SCROLLING_ZONE];
+
+#ifdef SPARSE_TILING_LAYERS
+// Parallax layers (SPARSE_TILING_LAYERS = 2 or 3). Each layer has its own sparse lines and horizontal position.
+// Line l * SPARSE_TILING_SCROLLING_ZONE + y is layer l of zone y. Layers are displayed back (0) to front, and
+// layer l scrolls at speed / 16 of the scroll offset (see sparse_tiling_set_layer_speed). All the layers of a zone
+// are reloaded together: with MULTISPRITE_USE_VIDEO_MEMORY, the zone holds the vmem cache references of all its
+// layers (up to SPARSE_TILING_LINE_ENTRIES tilesets per zone), and SPARSE_TILING_SCHEDULER budgets zone reloads.
+// Layers are plain 7 bytes records lines, given by pointer tables (see sparse_tiling_init_layer): the other line
+// formats (SOA, SEGMENTS, COMPRESSED, COLUMN_INDEX, RING) keep one line per zone and are out of the scope of layers
+#if defined(SPARSE_TILING_SOA) || defined(SPARSE_TILING_SEGMENTS) || defined(SPARSE_TILING_COMPRESSED) || defined(SPARSE_TILING_COLUMN_INDEX)
+#error SPARSE_TILING_LAYERS lines are plain 7 bytes records lines (no SOA, SEGMENTS, COMPRESSED or COLUMN_INDEX)
+#endif
+#define _ST_LINES (SPARSE_TILING_LAYERS * SPARSE_TILING_SCROLLING_ZONE)
+#define _ST_ZONE(y) _st_line_zone[Y = (y)]
+ramchip char _st_line_zone[_ST_LINES]; // Zone of each line
+ramchip char *_st_line_start[_ST_LINES];
+ramchip char _st_layer_end[2 * _ST_LINES]; // End of each layer in the zone DL (per buffer)
+ramchip char _st_layer_speed[SPARSE_TILING_LAYERS];
+ramchip signed char _st_layer_acc[2 * SPARSE_TILING_LAYERS], _st_layer_step[SPARSE_TILING_LAYERS];
+
+// speed: in 16ths of the scroll offset (16: same speed as the scroll offset, 8: half speed, 5: 5/16...).
+// Keep |offset| * speed < 112 so that the accumulated remainder fits in a signed char
+#define sparse_tiling_set_layer_speed(layer, speed) _st_layer_speed[X = (layer)] = (speed)
+
+// To be called after sparse_tiling_init (which sets up layer 0)
+#define sparse_tiling_init_layer(layer, ptr) \
+    _ms_sparse_tiles_ptr_high = ptr[Y = 0]; \
+    _ms_sparse_tiles_ptr_low = ptr[Y = 1]; \
+    _sparse_tiling_init_layer((layer) * SPARSE_TILING_SCROLLING_ZONE)
+#else
+#define _ST_LINES SPARSE_TILING_SCROLLING_ZONE
+#define _ST_ZONE(y) (y)
+#endif
+
+ramchip char *_tiling_ptr[_ST_LINES];
+ramchip signed char _tiling_xpos[2 * _ST_LINES], _tiling_xoffset[2 * _ST_LINES];
+
+#ifdef SPARSE_TILING_SOA
+#ifdef MULTISPRITE_USE_VIDEO_MEMORY
+#error SPARSE_TILING_SOA is not supported with MULTISPRITE_USE_VIDEO_MEMORY
+#endif
+#ifdef SPARSE_TILING_COLUMN_INDEX
+#error SPARSE_TILING_COLUMN_INDEX is for 7 bytes records. SoA lines start their scans from _tiling_idx
+#endif
+ramchip char _tiling_idx[SPARSE_TILING_SCROLLING_ZONE]; // First possibly visible tileset of each line
+
+// Sets up the array pointers of a SoA line
+#define _sparse_tiling_soa_arrays(ptr) \
+    n = ptr[Y = 0]; \
+    tend = ptr + 1; \
+    tstart = tend + n; \
+    tlow = tstart + n; \
+    tmode = tlow + n; \
+    thigh = tmode + n; \
+    tpw = thigh + n; \
+    tdma = tpw + n
+#endif
+
+#ifdef SPARSE_TILING_SEGMENTS
+// Long levels, made of segments of SPARSE_TILING_SEGMENT_WIDTH columns. Segment s of a line is a regular sparse line
+// holding the tilesets visible in columns [s * WIDTH, s * WIDTH + WIDTH + 32[, with X relative to s * WIDTH (tilesets
+// crossing this range are cut by the conversion tool). Each line has its own segment tables (high and low addresses
+// of its segments), so that a level can be 255 segments long. A line moves to the next (previous) segment when the
+// positions of both buffers have crossed the segment boundary, so that the switch costs nothing more than a line reload
+#ifndef SPARSE_TILING_SEGMENT_WIDTH
+#define SPARSE_TILING_SEGMENT_WIDTH 64 // Must be even, and keep X < 96 in segments
+#endif
+#ifdef SPARSE_TILING_COLUMN_INDEX
+#error SPARSE_TILING_COLUMN_INDEX is not supported with SPARSE_TILING_SEGMENTS
+#endif
+ramchip char *_st_seg_high[SPARSE_TILING_SCROLLING_ZONE], *_st_seg_low[SPARSE_TILING_SCROLLING_ZONE];
+ramchip char _tiling_seg[SPARSE_TILING_SCROLLING_ZONE], _st_last_segment;
+
+// high and low are arrays (one entry per line) of the segment high and low address tables of each line.
+// With video memory, set _sparse_tiling_charbase before
+#define sparse_tiling_init_segments(high, low, nb_segments) \
+    for (Y = SPARSE_TILING_SCROLLING_ZONE - 1; Y >= 0; Y--) { \
+        _st_seg_high[Y] = high[Y]; \
+        _st_seg_low[Y] = low[Y]; \
+    } \
+    _st_last_segment = (nb_segments) - 1; \
+    _sparse_tiling_init()
+#endif
+
+// SPARSE_TILING_BIDIRECTIONAL allows scrolling left too (negative offsets)
+#ifdef SPARSE_TILING_BIDIRECTIONAL
+#define _ST_OFFSET signed char
+#else
+#define _ST_OFFSET char
+#endif
+
+#ifdef SPARSE_TILING_SCHEDULER
+#ifndef SPARSE_TILING_BUDGET
+#define SPARSE_TILING_BUDGET 40 // Time allowed for line reloads per frame, in TIM64T intervals (64 cycles each)
+#endif
+// Initial estimate of a line reload time, in TIM64T intervals: ~8 tilesets at ~170 cycles each, more with the
+// vmem uploads. The scheduler raises it to the longest reload it measures
+#ifndef SPARSE_TILING_LINE_COST
+#ifdef MULTISPRITE_USE_VIDEO_MEMORY
+#define SPARSE_TILING_LINE_COST 64
+#else
+#define SPARSE_TILING_LINE_COST 24
+#endif
+#endif
+#ifdef SPARSE_TILING_LAYERS
+#define _ST_RELOAD_COST (SPARSE_TILING_LINE_COST * SPARSE_TILING_LAYERS) // A zone reload reloads all its layers
+#else
+#define _ST_RELOAD_COST SPARSE_TILING_LINE_COST
+#endif
+ramchip char _sparse_tiling_budget, _sparse_tiling_line_cost, _sparse_tiling_next[2];
+#define sparse_tiling_set_budget(n) _sparse_tiling_budget = (n)
+#endif
 
 #ifdef MULTISPRITE_USE_VIDEO_MEMORY
 ramchip char _sparse_tiling_vmem_ptr_low, _sparse_tiling_vmem_ptr_high, _sparse_tiling_charbase;
-#define IDATA_MAX 5
-ramchip char *_st_idata[IDATA_MAX * SPARSE_TILING_SCROLLING_ZONE];
-const char _st_idata_idx[14] = { 0, IDATA_MAX, IDATA_MAX * 2, IDATA_MAX * 3, IDATA_MAX * 4, IDATA_MAX * 5, IDATA_MAX * 6, IDATA_MAX * 7, IDATA_MAX * 8, IDATA_MAX * 9, IDATA_MAX * 10, IDATA_MAX * 11, IDATA_MAX * 12, IDATA_MAX * 13 };
-ramchip char _st_idata_size[SPARSE_TILING_SCROLLING_ZONE];
+
+// Video memory tileset cache. Tilesets are uploaded once in a vmem slot, keyed by their ROM address, and shared
+// by all the lines that display them. Each line of each buffer holds a reference on the slots its DL shows, so a
+// slot is only recycled (least recently used first) when no DL shows it anymore. A tileset that doesn't fit
+// in a slot, or that can't get a slot because the cache is full, is not displayed and counted in _ms_dmaerror.
+#ifndef SPARSE_TILING_VMEM_SLOT_SIZE
+#define SPARSE_TILING_VMEM_SLOT_SIZE 32 // Bytes per vmem page. A tileset must fit in a slot (16 tiles in 160A, 8 in 160B)
+#endif
+#define _ST_CACHE_SIZE (768 / SPARSE_TILING_VMEM_SLOT_SIZE)
+ramchip char _st_cache_rom_low[_ST_CACHE_SIZE], _st_cache_rom_high[_ST_CACHE_SIZE];
+ramchip char _st_cache_vmem_low[_ST_CACHE_SIZE], _st_cache_vmem_high[_ST_CACHE_SIZE];
+ramchip char _st_cache_refcount[_ST_CACHE_SIZE], _st_cache_age[_ST_CACHE_SIZE];
+ramchip char _st_cache_clock, _st_cache_entry;
+
+#ifdef SPARSE_TILING_VMEM_ANIMATION
+// Animated tiles: the frames of an animated tile are consecutive tiles in the tileset. The vmem copies that use
+// animated tiles are refreshed in bounded slices (see sparse_tiling_animate), so that no DL is ever touched
+#ifndef SPARSE_TILING_ANIM_BUDGET
+#define SPARSE_TILING_ANIM_BUDGET 40 // Time allowed for vmem refreshes per frame, in TIM64T intervals (~1 scanline each)
+#endif
+#ifndef SPARSE_TILING_ANIM_SLOT_COST
+#define SPARSE_TILING_ANIM_SLOT_COST 20 // Time of a slot refresh (~2 entries), in TIM64T intervals
+#endif
+#define _ST_ANIM_MAX 8
+ramchip char _st_anim_tile[_ST_ANIM_MAX], _st_anim_offset[_ST_ANIM_MAX], _st_anim_last[_ST_ANIM_MAX], _st_anim_period[_ST_ANIM_MAX], _st_anim_counter[_ST_ANIM_MAX];
+ramchip char _st_anim_nb;
+ramchip char _st_cache_w[_ST_CACHE_SIZE], _st_cache_mode[_ST_CACHE_SIZE];
+// Each slot records the animation stamp it was uploaded with. The refresh sweep goes round robin over the slots,
+// resuming where it stopped, so a new animation step never starves the slots the sweep hasn't reached yet
+ramchip char _st_cache_stamp[_ST_CACHE_SIZE];
+ramchip char _st_anim_stamp, _st_anim_cursor, _st_anim_pending;
+
+// tile: first frame (tile index, as in the tilesets), period: number of frames per animation step
+#define sparse_tiling_animated_tile(tile, nb_frames, period) \
+    X = _st_anim_nb; \
+    _st_anim_nb++; \
+    _st_anim_tile[X] = (tile); \
+    _st_anim_offset[X] = 0; \
+    _st_anim_last[X] = ((nb_frames) - 1) << 1; \
+    _st_anim_period[X] = (period); \
+    _st_anim_counter[X] = (period);
+#endif
+
+// Cache entries referenced by each line of each buffer (lines of buffer 1 come after the ones of buffer 0).
+// Tilesets past SPARSE_TILING_LINE_ENTRIES on a line are not displayed (and counted in _ms_dmaerror).
+// With SPARSE_TILING_LAYERS, the references are kept per zone (all its layers)
+#ifndef SPARSE_TILING_LINE_ENTRIES
+#define SPARSE_TILING_LINE_ENTRIES 6
+#endif
+#define _ST_LINE_ENTRIES_MAX SPARSE_TILING_LINE_ENTRIES
+ramchip char _st_line_entries[_ST_LINE_ENTRIES_MAX * 2 * SPARSE_TILING_SCROLLING_ZONE];
+const char _st_line_entries_idx[28] = { 0, _ST_LINE_ENTRIES_MAX, _ST_LINE_ENTRIES_MAX * 2, _ST_LINE_ENTRIES_MAX * 3, _ST_LINE_ENTRIES_MAX * 4, _ST_LINE_ENTRIES_MAX * 5, _ST_LINE_ENTRIES_MAX * 6, _ST_LINE_ENTRIES_MAX * 7, _ST_LINE_ENTRIES_MAX * 8, _ST_LINE_ENTRIES_MAX * 9, _ST_LINE_ENTRIES_MAX * 10, _ST_LINE_ENTRIES_MAX * 11, _ST_LINE_ENTRIES_MAX * 12, _ST_LINE_ENTRIES_MAX * 13,
+    _ST_LINE_ENTRIES_MAX * 14, _ST_LINE_ENTRIES_MAX * 15, _ST_LINE_ENTRIES_MAX * 16, _ST_LINE_ENTRIES_MAX * 17, _ST_LINE_ENTRIES_MAX * 18, _ST_LINE_ENTRIES_MAX * 19, _ST_LINE_ENTRIES_MAX * 20, _ST_LINE_ENTRIES_MAX * 21, _ST_LINE_ENTRIES_MAX * 22, _ST_LINE_ENTRIES_MAX * 23, _ST_LINE_ENTRIES_MAX * 24, _ST_LINE_ENTRIES_MAX * 25, _ST_LINE_ENTRIES_MAX * 26, _ST_LINE_ENTRIES_MAX * 27 };
+ramchip char _st_line_nb_entries[2 * SPARSE_TILING_SCROLLING_ZONE];
 
 bank1 char multisprite_vmem[12288]; // Video memory in RAM
 bank1 const char sparse_tiling_vmem_use_rom[] = {1};
@@ -45,8 +210,6 @@ bank1 const char sparse_tiling_vmem_use_rom[] = {1};
     _ms_sparse_tiles_ptr_high = ptr[Y = 0]; \
     _ms_sparse_tiles_ptr_low = ptr[Y = 1]; \
     _sparse_tiling_charbase = (tiles_ptr) >> 8; \
-    _sparse_tiling_vmem_ptr_low = 0x00; \
-    _sparse_tiling_vmem_ptr_high = 0x40; \
     _sparse_tiling_init(); \
 } 
 #else
@@ -56,46 +219,578 @@ bank1 const char sparse_tiling_vmem_use_rom[] = {1};
     _sparse_tiling_init()
 #endif
 
+const char _sparse_tiling_end_of_tileset[2] = { 96, 0xff};
+
+#ifdef SPARSE_TILING_RING
+// Runtime generated sparse lines (procedural / endless levels), in RAM with the usual 7 bytes records. Tilesets are
+// appended on the right of each line, and the ones scrolled out on the left are recycled when the line is full.
+// X are relative to the frame of the line, which is moved to the left of the screen at each recycling (_tiling_xpos
+// follows). Keep the generation less than 64 columns ahead of the screen (see sparse_tiling_ring_ahead)
+#if defined(SPARSE_TILING_SOA) || defined(SPARSE_TILING_SEGMENTS) || defined(SPARSE_TILING_COMPRESSED) || defined(SPARSE_TILING_LAYERS) || defined(SPARSE_TILING_COLUMN_INDEX)
+#error SPARSE_TILING_RING only supports the 7 bytes records format
+#endif
+#ifndef SPARSE_TILING_RING_SIZE
+#define SPARSE_TILING_RING_SIZE 64 // Bytes per line (8 tilesets + end of line marker)
+#endif
+ramchip char _st_ring[SPARSE_TILING_RING_SIZE * SPARSE_TILING_SCROLLING_ZONE];
+ramchip char _st_ring_end[SPARSE_TILING_SCROLLING_ZONE]; // Offset of the end of line marker
+ramchip signed char _st_ring_cursor[SPARSE_TILING_SCROLLING_ZONE]; // Last generated column
+ramchip char _st_ring_dirty[2 * SPARSE_TILING_SCROLLING_ZONE]; // Lines edited since their last load (per buffer)
+char *_st_ring_ptr;
+#define _ST_RING_DIRTY() _st_ring_dirty[X]
+
+#define sparse_tiling_init_ring() _sparse_tiling_init()
+// Number of columns generated ahead of the left of the screen
+#define sparse_tiling_ring_ahead(y) (_st_ring_cursor[X = (y)] - _tiling_xpos[X])
+// Leaves n empty columns
+#define sparse_tiling_ring_skip(y, n) _st_ring_cursor[X = (y)] += (n)
+// Appends count tiles (gfx: tile indexes in indirect mode, graphics otherwise) right after the last generated column.
+// Returns 0 if the line is full
+#define sparse_tiling_ring_append(y, count, gfx, mode, palette) _sparse_tiling_ring_append(y, count, (gfx), (gfx) >> 8, mode, (palette) << 5)
+// Changes the tile at column x of line y (destructible scenery, pickups...), x being an already generated column in the
+// frame of the line (_tiling_xpos + screen column). The tileset covering x is split around it, and the new tile gets
+// a 1 tile tileset (gfx as in sparse_tiling_ring_append). The line is reloaded in both buffers by sparse_tiling_scroll.
+// Returns 0 if the line is full (up to 2 more tilesets are needed)
+#define sparse_tiling_ring_set_tile(y, x, gfx, mode, palette) _sparse_tiling_ring_set_tile(y, x, (gfx), (gfx) >> 8, mode, (palette) << 5)
+#define sparse_tiling_ring_clear_tile(y, x) _sparse_tiling_ring_set_tile(y, x, 0, 0, 0, 0)
+
+// Points _st_ring_ptr to the ring of line y
+void _sparse_tiling_ring_line(char y)
+{
+    _st_ring_ptr = _st_ring;
+    for (X = y; X; X--) {
+        _st_ring_ptr += SPARSE_TILING_RING_SIZE;
+    }
+}
+
+// Recycles the tilesets of line y that both buffers have scrolled out, and moves the frame of the line
+void _sparse_tiling_ring_recycle(char y)
+{
+    char *ptr, *src, live, end;
+    signed char xmin, r;
+    X = y;
+    xmin = _tiling_xpos[X];
+    r = _tiling_xpos[X = y + SPARSE_TILING_SCROLLING_ZONE];
+    if (r < xmin) xmin = r;
+    _sparse_tiling_ring_line(y);
+    ptr = _st_ring_ptr;
+    end = _st_ring_end[X = y];
+    // First tileset still visible in one of the buffers
+    for (Y = 0; Y != end; Y += _STS_SIZE) {
+        r = ptr[Y] - xmin;
+        if (r >= 0) break;
+    }
+    live = Y;
+    if (!live) return;
+    src = ptr + live;
+    end = end + 2 - live; // Including the end of line marker
+    for (Y = 0; Y != end; Y++) {
+        ptr[Y] = src[Y];
+    }
+    end -= 2;
+    _st_ring_end[X] = end;
+    _tiling_ptr[X] = ptr;
+    if (xmin > 0) {
+        for (Y = 0; Y != end; Y += _STS_SIZE - 1) {
+            ptr[Y] -= xmin; // End
+            ptr[++Y] -= xmin; // Beginning
+        }
+        _st_ring_cursor[X] -= xmin;
+        _tiling_xpos[X] -= xmin;
+        _tiling_xpos[X = y + SPARSE_TILING_SCROLLING_ZONE] -= xmin;
+    }
+}
+
+// Writes at offset at of the line pointed by _st_ring_ptr the record of count tiles from column start.
+// Returns the offset right after it
+char _sparse_tiling_ring_record(char at, char start, char count, char low, char high, char mode, char palette)
+{
+    char *ptr, w, dma;
+    // Width and DMA cost, as multisprite_display_tiles ((10 + 3 + w * 9 + 1) / 2) and multisprite_display_sprite
+    // ((8 + w * 3 + 1) / 2) count them. Computed without overflowing 8 bits (w <= 31)
+    if (mode & 0x20) {
+        w = count;
+        dma = 7 + (w << 2) + (w >> 1);
+    } else {
+        w = count << 1;
+        dma = (9 + (w << 1) + w) >> 1;
+    }
+    ptr = _st_ring_ptr;
+    Y = at;
+    ptr[Y] = start + count - 1; // End
+    ptr[++Y] = start;
+    ptr[++Y] = low;
+    ptr[++Y] = mode;
+    ptr[++Y] = high;
+    ptr[++Y] = palette | (-w & 0x1f);
+    ptr[++Y] = dma;
+    Y++;
+    return Y;
+}
+
+char _sparse_tiling_ring_append(char y, char count, char low, char high, char mode, char palette)
+{
+    char *ptr, start, at;
+    X = y;
+    if (_st_ring_end[X] + (_STS_SIZE + 2) > SPARSE_TILING_RING_SIZE) {
+        _sparse_tiling_ring_recycle(y);
+        X = y;
+        if (_st_ring_end[X] + (_STS_SIZE + 2) > SPARSE_TILING_RING_SIZE) return 0;
+    }
+    _sparse_tiling_ring_line(y);
+    X = y;
+    start = _st_ring_cursor[X] + 1;
+    _st_ring_cursor[X] += count;
+    at = _sparse_tiling_ring_record(_st_ring_end[X], start, count, low, high, mode, palette);
+    ptr = _st_ring_ptr;
+    Y = at;
+    ptr[Y] = 96; // End of line marker
+    ptr[++Y] = 0xff;
+    _st_ring_end[X = y] += _STS_SIZE;
+    return 1;
+}
+
+char _sparse_tiling_ring_set_tile(char y, char x, char low, char high, char mode, char palette)
+{
+    char *ptr, *src, *dst, at, end, size, n, count, left, right, step;
+    char olow, ohigh, omode, opalette;
+    signed char r, delta;
+    X = y;
+    r = x - _st_ring_cursor[X];
+    if (r > 0) return 0; // Not generated yet
+    _sparse_tiling_ring_line(y);
+    ptr = _st_ring_ptr;
+    end = _st_ring_end[X = y];
+    // First tileset ending at or after x
+    for (Y = 0; Y != end; Y += _STS_SIZE) {
+        r = ptr[Y] - x;
+        if (r >= 0) break;
+    }
+    at = Y;
+    size = 0; // Bytes of the tileset covering x, replaced by the new records
+    left = 0;
+    right = 0;
+    if (at != end) {
+        r = x - ptr[++Y];
+        if (r >= 0) { // x is in this tileset
+            size = _STS_SIZE;
+            left = r;
+            right = ptr[Y = at] - x;
+            Y += 2;
+            olow = ptr[Y];
+            omode = ptr[++Y];
+            ohigh = ptr[++Y];
+            opalette = ptr[++Y] & 0xe0;
+        }
+    }
+    n = 0; // Bytes of the new records
+    if (left) n += _STS_SIZE;
+    if (high) n += _STS_SIZE;
+    if (right) n += _STS_SIZE;
+    if (!n && !size) return 1; // Empty column cleared
+    if (end + n - size + 2 > SPARSE_TILING_RING_SIZE) return 0;
+    // Move the following tilesets and the end of line marker
+    delta = n - size;
+    src = ptr + at + size;
+    dst = ptr + at + n;
+    count = end + 2 - at - size;
+    if (delta > 0) {
+        for (Y = count - 1; Y >= 0; Y--) {
+            dst[Y] = src[Y];
+        }
+    } else if (delta < 0) {
+        for (Y = 0; Y != count; Y++) {
+            dst[Y] = src[Y];
+        }
+    }
+    _st_ring_end[X = y] = end + delta;
+    // Keep _tiling_ptr on the same tileset when the change is on its left
+    src = ptr + at;
+    if (_tiling_ptr[X] > src) {
+        if (delta > 0) _tiling_ptr[X] += delta;
+        else _tiling_ptr[X] -= -delta;
+    }
+    // The new records
+    if (left) at = _sparse_tiling_ring_record(at, x - left, left, olow, ohigh, omode, opalette);
+    if (high) at = _sparse_tiling_ring_record(at, x, 1, low, high, mode, palette);
+    if (right) {
+        // The tiles after x, further in the graphics (1 byte per tile in indirect mode, 2 otherwise)
+        step = left + 1;
+        if (!(omode & 0x20)) step <<= 1;
+        olow += step;
+        if (olow < step) ohigh++;
+        _sparse_tiling_ring_record(at, x + 1, right, olow, ohigh, omode, opalette);
+    }
+    _st_ring_dirty[X = y] = 1;
+    _st_ring_dirty[X = y + SPARSE_TILING_SCROLLING_ZONE] = 1;
+    return 1;
+}
+#endif
+
+#ifdef SPARSE_TILING_COMPRESSED
+// Compressed sparse lines, decoded into a RAM line cache when they enter (at init, or on segment change):
+//    Number of tilesets n
+//    n times 4 bytes:
+//        Gap from the end of the previous tileset (in columns, -1 for the first one)
+//        Number of tiles - 1 (bits 0-4) | Style (bits 5-7)
+//        Low address
+//        High address
+// The styles (up to 8) are shared by all the lines, 4 bytes each:
+//    Mode byte
+//    Palette (bits 5-7) | 1 if the tiles are 2 bytes wide in the DL (bit 0)
+//    DMA cost of the tileset header
+//    DMA cost per tile
+#ifndef SPARSE_TILING_LINE_CACHE_SIZE
+#define SPARSE_TILING_LINE_CACHE_SIZE 64 // Bytes of decoded tilesets per line (8 tilesets + end of line marker)
+#endif
+// A line can hold at most _ST_LINE_CACHE_RECORDS tilesets. The ones past this limit are not displayed
+// (and counted in _ms_dmaerror): raise SPARSE_TILING_LINE_CACHE_SIZE to fit the busiest line of the map
+#define _ST_LINE_CACHE_RECORDS ((SPARSE_TILING_LINE_CACHE_SIZE - 2) / _STS_SIZE)
+#ifdef SPARSE_TILING_SOA
+#error SPARSE_TILING_COMPRESSED is not supported with SPARSE_TILING_SOA
+#endif
+#ifdef SPARSE_TILING_COLUMN_INDEX
+#error SPARSE_TILING_COMPRESSED is not supported with SPARSE_TILING_COLUMN_INDEX
+#endif
+ramchip char _st_line_cache[SPARSE_TILING_LINE_CACHE_SIZE * SPARSE_TILING_SCROLLING_ZONE];
+ramchip char _st_styles[32];
+char *_st_line_cache_ptr;
+
+// To be called before sparse_tiling_init (or sparse_tiling_init_vmem, sparse_tiling_init_segments)
+#define sparse_tiling_init_styles(styles) \
+    for (X = 31; X >= 0; X--) { \
+        _st_styles[X] = styles[X]; \
+    }
+
+// Points _st_line_cache_ptr to the line cache of line y
+void _sparse_tiling_line_cache(char y)
+{
+    _st_line_cache_ptr = _st_line_cache;
+    for (X = y; X; X--) {
+        _st_line_cache_ptr += SPARSE_TILING_LINE_CACHE_SIZE;
+    }
+}
+
+// Decodes the compressed line src into the line cache of line y, and points line y to it
+void _sparse_tiling_decode_line(char y, char *src)
+{
+    char *dst, n, i, end, start, count, w, dma, tmp;
+    _sparse_tiling_line_cache(y);
+    dst = _st_line_cache_ptr;
+    _tiling_ptr[X = y] = dst;
+    n = src[Y = 0];
+    if (n > _ST_LINE_CACHE_RECORDS) {
+        n = _ST_LINE_CACHE_RECORDS;
+        _ms_dmaerror++;
+    }
+    src++;
+    end = -1;
+    for (i = 0; i != n; i++) {
+        start = end + 1 + src[Y = 0];
+        tmp = src[Y = 1];
+        count = (tmp & 0x1f) + 1;
+        X = (tmp >> 3) & 0x1c; // Style * 4
+        end = start + count - 1;
+        dst[Y = 0] = end;
+        dst[Y = 1] = start;
+        tmp = src[Y = 2];
+        dst[Y] = tmp; // Low address
+        dst[Y = 3] = _st_styles[X++]; // Mode byte
+        tmp = src[Y];
+        dst[Y = 4] = tmp; // High address
+        w = count;
+        if (_st_styles[X] & 1) w <<= 1;
+        dst[Y = 5] = (_st_styles[X++] & 0xe0) | (-w & 0x1f); // Palette & width
+        dma = _st_styles[X++];
+        tmp = _st_styles[X];
+        for (X = count; X; X--) dma += tmp;
+        dst[Y = 6] = dma;
+        src += 4;
+        dst += _STS_SIZE;
+    }
+    dst[Y = 0] = 96;
+    dst[Y = 1] = 0xff;
+}
+
+#define _sparse_tiling_set_line(y, ptr) _sparse_tiling_decode_line(y, ptr)
+#else
+#define _sparse_tiling_set_line(y, ptr) _tiling_ptr[X = y] = ptr
+#endif
+
+#ifndef SPARSE_TILING_RING
+#define _ST_RING_DIRTY() 0
+#endif
+
 void _sparse_tiling_init()
 {
     char *ptr;
-    for (Y = SPARSE_TILING_SCROLLING_ZONE - 1; Y >= 0; Y--) {
+    signed char y;
+#ifdef SPARSE_TILING_SEGMENTS
+    char *sh, *sl;
+#endif
+    for (y = SPARSE_TILING_SCROLLING_ZONE - 1; y >= 0; y--) {
+#ifdef SPARSE_TILING_SEGMENTS
+        sh = _st_seg_high[X = y];
+        sl = _st_seg_low[X];
+        ptr = sl[Y = 0] | (sh[Y] << 8);
+        _tiling_seg[X] = 0;
+#elif defined(SPARSE_TILING_RING)
+        _sparse_tiling_ring_line(y);
+        ptr = _st_ring_ptr;
+        ptr[Y = 0] = 96; // Empty line
+        ptr[Y = 1] = 0xff;
+        _st_ring_end[X = y] = 0;
+        _st_ring_cursor[X] = -1;
+        _st_ring_dirty[X] = 0;
+        _st_ring_dirty[X = y + SPARSE_TILING_SCROLLING_ZONE] = 0;
+#else
+        Y = y;
         ptr = _ms_sparse_tiles_ptr_low[Y] | (_ms_sparse_tiles_ptr_high[Y] << 8);   
-        _tiling_ptr[Y] = ptr;
+#endif
+        _sparse_tiling_set_line(y, ptr);
     }
-    for (X = 2 * SPARSE_TILING_SCROLLING_ZONE - 1; X >= 0; X--) {
+    for (X = 2 * _ST_LINES - 1; X >= 0; X--) {
         _tiling_xpos[X] = 0;
         _tiling_xoffset[X] = 0;
     }
-#ifdef MULTISPRITE_USE_VIDEO_MEMORY
+#ifdef SPARSE_TILING_LAYERS
+    Y = 0;
+    for (X = 0; X != _ST_LINES; X++) {
+        _st_line_zone[X] = Y;
+        if (++Y == SPARSE_TILING_SCROLLING_ZONE) Y = 0;
+        if (X >= SPARSE_TILING_SCROLLING_ZONE) { // Empty until set by sparse_tiling_init_layer
+            _tiling_ptr[X] = _sparse_tiling_end_of_tileset;
+            _st_line_start[X] = _sparse_tiling_end_of_tileset;
+        } else {
+            _st_line_start[X] = _tiling_ptr[X];
+        }
+    }
+    for (X = 2 * SPARSE_TILING_LAYERS - 1; X >= 0; X--) {
+        _st_layer_acc[X] = 0;
+    }
+    for (X = SPARSE_TILING_LAYERS - 1; X >= 0; X--) {
+        _st_layer_speed[X] = 16;
+    }
+#endif
+#ifdef SPARSE_TILING_SOA
     for (X = SPARSE_TILING_SCROLLING_ZONE - 1; X >= 0; X--) {
-        _st_idata_size[X] = 0;     
+        _tiling_idx[X] = 0;
+    }
+#endif
+#ifdef SPARSE_TILING_SCHEDULER
+    _sparse_tiling_budget = SPARSE_TILING_BUDGET;
+    _sparse_tiling_line_cost = _ST_RELOAD_COST;
+    _sparse_tiling_next[X = 0] = 0;
+    _sparse_tiling_next[++X] = 0;
+#endif
+#ifdef MULTISPRITE_USE_VIDEO_MEMORY
+    for (X = 2 * SPARSE_TILING_SCROLLING_ZONE - 1; X >= 0; X--) {
+        _st_line_nb_entries[X] = 0;     
     }
+    // Cut the vmem (0x4000-0x6fff) into slots
+    Y = 0;
+    _ms_tmp = 0x40;
+    for (X = 0; X != _ST_CACHE_SIZE; X++) {
+        _st_cache_vmem_low[X] = Y;
+        _st_cache_vmem_high[X] = _ms_tmp;
+        _st_cache_rom_high[X] = 0; // Empty (no tileset in zero page)
+        _st_cache_refcount[X] = 0;
+        _st_cache_age[X] = 0;
+        Y += SPARSE_TILING_VMEM_SLOT_SIZE;
+        if (!Y) _ms_tmp += 16;
+    }
+    _st_cache_clock = 0;
+#ifdef SPARSE_TILING_VMEM_ANIMATION
+    _st_anim_nb = 0;
+    _st_anim_stamp = 0;
+    _st_anim_cursor = 0;
+    _st_anim_pending = 0;
+#endif
 #endif
 }
 
-const char _sparse_tiling_end_of_tileset[2] = { 96, 0xff};
+#ifdef SPARSE_TILING_LAYERS
+// Points the lines of the layer starting at line v to the sparse lines in _ms_sparse_tiles_ptr_high/low
+void _sparse_tiling_init_layer(char v)
+{
+    char *ptr;
+    for (Y = 0; Y != SPARSE_TILING_SCROLLING_ZONE; Y++) {
+        ptr = _ms_sparse_tiles_ptr_low[Y] | (_ms_sparse_tiles_ptr_high[Y] << 8);   
+        X = v + Y;
+        _tiling_ptr[X] = ptr;
+        _st_line_start[X] = ptr;
+    }
+}
+#endif
+
+#ifdef SPARSE_TILING_SEGMENTS
+// Moves line y to the next (or previous) segment once the positions of both buffers are past the segment boundary.
+// The line is then scanned from the start of its new segment
+void _sparse_tiling_segment_check(char y)
+{
+    char *ptr, *sh, *sl;
+    signed char xmin, shift;
+    X = y;
+    xmin = _tiling_xpos[X];
+    shift = _tiling_xpos[X = y + SPARSE_TILING_SCROLLING_ZONE];
+    if (shift < xmin) xmin = shift;
+    X = y;
+    if (xmin >= SPARSE_TILING_SEGMENT_WIDTH) {
+        if (_tiling_seg[X] == _st_last_segment) return;
+        _tiling_seg[X]++;
+        shift = -SPARSE_TILING_SEGMENT_WIDTH;
+    } else if (xmin < 0) {
+        if (!_tiling_seg[X]) return;
+        _tiling_seg[X]--;
+        shift = SPARSE_TILING_SEGMENT_WIDTH;
+    } else return;
+    _tiling_xpos[X] += shift;
+    sh = _st_seg_high[X];
+    sl = _st_seg_low[X];
+    Y = _tiling_seg[X];
+    ptr = sl[Y] | (sh[Y] << 8);
+    _tiling_xpos[X = y + SPARSE_TILING_SCROLLING_ZONE] += shift;
+#ifdef SPARSE_TILING_SOA
+    _tiling_idx[X = y] = 0;
+#endif
+    _sparse_tiling_set_line(y, ptr);
+}
+#endif
+
+#ifdef SPARSE_TILING_BIDIRECTIONAL
+// Scrolling left: steps _tiling_ptr back over the tilesets that came back in view.
+// Records have a fixed size, so this costs the same as going forward (no rescan from the start of the line)
+void _sparse_tiling_step_back(char y, signed char txpos)
+{
+    char *ptr, *start;
+    signed char r;
+#ifdef SPARSE_TILING_SEGMENTS
+    char *sh, *sl;
+    X = y;
+    ptr = _tiling_ptr[X];
+    sh = _st_seg_high[X];
+    sl = _st_seg_low[X];
+    Y = _tiling_seg[X];
+    start = sl[Y] | (sh[Y] << 8);
+#elif defined(SPARSE_TILING_LAYERS)
+    Y = y;
+    ptr = _tiling_ptr[Y];
+    start = _st_line_start[Y];
+#elif defined(SPARSE_TILING_RING)
+    ptr = _tiling_ptr[X = y];
+    _sparse_tiling_ring_line(y);
+    start = _st_ring_ptr;
+#else
+    Y = y;
+    ptr = _tiling_ptr[Y];
+    start = _ms_sparse_tiles_ptr_low[Y] | (_ms_sparse_tiles_ptr_high[Y] << 8);
+#endif
+#ifdef SPARSE_TILING_COMPRESSED
+    _sparse_tiling_line_cache(y);
+    start = _st_line_cache_ptr;
+#endif
+    while (ptr != start) {
+        ptr -= _STS_SIZE;
+        r = ptr[Y = 0] - txpos;
+        if (r < 0) {
+            ptr += _STS_SIZE;
+            break;
+        }
+    }
+    _tiling_ptr[Y = y] = ptr;
+}
+#endif
 
 #ifdef MULTISPRITE_USE_VIDEO_MEMORY
+// 16 lines tile column copy: from the tiles (column Y) to vtmp, then from vtmp to vmem (column Y)
+#define _ST_LOAD_COLUMN() \
+    vtmp[0] = chptr0[Y]; \
+    vtmp[1] = chptr1[Y]; \
+    vtmp[2] = chptr2[Y]; \
+    vtmp[3] = chptr3[Y]; \
+    vtmp[4] = chptr4[Y]; \
+    vtmp[5] = chptr5[Y]; \
+    vtmp[6] = chptr6[Y]; \
+    vtmp[7] = chptr7[Y]; \
+    vtmp[8] = chptr8[Y]; \
+    vtmp[9] = chptr9[Y]; \
+    vtmp[10] = chptr10[Y]; \
+    vtmp[11] = chptr11[Y]; \
+    vtmp[12] = chptr12[Y]; \
+    vtmp[13] = chptr13[Y]; \
+    vtmp[14] = chptr14[Y]; \
+    vtmp[15] = chptr15[Y];
+
+#define _ST_STORE_COLUMN() \
+    vmemptr0[Y] = vtmp[0]; \
+    vmemptr1[Y] = vtmp[1]; \
+    vmemptr2[Y] = vtmp[2]; \
+    vmemptr3[Y] = vtmp[3]; \
+    vmemptr4[Y] = vtmp[4]; \
+    vmemptr5[Y] = vtmp[5]; \
+    vmemptr6[Y] = vtmp[6]; \
+    vmemptr7[Y] = vtmp[7]; \
+    vmemptr8[Y] = vtmp[8]; \
+    vmemptr9[Y] = vtmp[9]; \
+    vmemptr10[Y] = vtmp[10]; \
+    vmemptr11[Y] = vtmp[11]; \
+    vmemptr12[Y] = vtmp[12]; \
+    vmemptr13[Y] = vtmp[13]; \
+    vmemptr14[Y] = vtmp[14]; \
+    vmemptr15[Y] = vtmp[15];
+
+#define _ST_STORE_COLUMN_MIRRORED() \
+    vmemptr0[Y] = vtmp[15]; \
+    vmemptr1[Y] = vtmp[14]; \
+    vmemptr2[Y] = vtmp[13]; \
+    vmemptr3[Y] = vtmp[12]; \
+    vmemptr4[Y] = vtmp[11]; \
+    vmemptr5[Y] = vtmp[10]; \
+    vmemptr6[Y] = vtmp[9]; \
+    vmemptr7[Y] = vtmp[8]; \
+    vmemptr8[Y] = vtmp[7]; \
+    vmemptr9[Y] = vtmp[6]; \
+    vmemptr10[Y] = vtmp[5]; \
+    vmemptr11[Y] = vtmp[4]; \
+    vmemptr12[Y] = vtmp[3]; \
+    vmemptr13[Y] = vtmp[2]; \
+    vmemptr14[Y] = vtmp[1]; \
+    vmemptr15[Y] = vtmp[0];
+
+#ifdef SPARSE_TILING_UNROLLED_UPLOAD
+// Upload of entry i (a constant) of the tileset: no loop counter, constant destination columns
+#define _ST_UPLOAD_ENTRY(i) \
+    Y = sptr[Y = i]; \
+    if (Y & 1) { \
+        _ST_LOAD_COLUMN(); \
+        Y = (i) * 2 + 1; \
+        _ST_STORE_COLUMN_MIRRORED(); \
+        Y = sptr[Y = i]; \
+        Y--; \
+        _ST_LOAD_COLUMN(); \
+        Y = (i) * 2; \
+        _ST_STORE_COLUMN_MIRRORED(); \
+    } else { \
+        Y++; \
+        _ST_LOAD_COLUMN(); \
+        Y = (i) * 2 + 1; \
+        _ST_STORE_COLUMN(); \
+        Y = sptr[Y = i]; \
+        _ST_LOAD_COLUMN(); \
+        Y = (i) * 2; \
+        _ST_STORE_COLUMN(); \
+    }
+#endif
+
 char _sparse_tiling_ROM_to_RAM(char *sptr, char w, char mode)
 {
-    char low, high, len, len2, tmp, mirroring;
+    char low, high, len2, tmp, tile, mirroring;
 
     len2 = (mode)?(w << 1):w; // Number of entries in chptr
-    len = len2 << 1; // Number of actual bytes
 
+    // Destination slot was chosen by _sparse_tiling_vmem_get
     low = _sparse_tiling_vmem_ptr_low;
     high = _sparse_tiling_vmem_ptr_high;
-    // Allocate n bytes in vmem
-    tmp = low - len;
-    if (tmp < 0) {
-        low = -len;
-        high += 16;
-        if (high == 0x70) high = 0x40;
-    } else low = tmp;
-
-    _sparse_tiling_vmem_ptr_low = low;
-    _sparse_tiling_vmem_ptr_high = high;
 
     char *vmemptr0, *vmemptr1, *vmemptr2, *vmemptr3, *vmemptr4, *vmemptr5, *vmemptr6, *vmemptr7, *vmemptr8, *vmemptr9, *vmemptr10, *vmemptr11, *vmemptr12, *vmemptr13, *vmemptr14, *vmemptr15;
     char *chptr0, *chptr1, *chptr2, *chptr3, *chptr4, *chptr5, *chptr6, *chptr7, *chptr8, *chptr9, *chptr10, *chptr11, *chptr12, *chptr13, *chptr14, *chptr15;
@@ -138,9 +833,42 @@ char _sparse_tiling_ROM_to_RAM(char *sptr, char w, char mode)
     chptr14 = X++ << 8;
     chptr15 = X++ << 8;
 
+#if defined(SPARSE_TILING_UNROLLED_UPLOAD) && !defined(SPARSE_TILING_VMEM_ANIMATION)
+    // Width specialized kernels for the most common tilesets (160B tiles use 2 entries)
+    if (len2 == 1) {
+        _ST_UPLOAD_ENTRY(0);
+        return 1;
+    } else if (len2 == 2) {
+        _ST_UPLOAD_ENTRY(0);
+        _ST_UPLOAD_ENTRY(1);
+        return 2;
+    } else if (len2 == 3) {
+        _ST_UPLOAD_ENTRY(0);
+        _ST_UPLOAD_ENTRY(1);
+        _ST_UPLOAD_ENTRY(2);
+        return 3;
+    } else if (len2 == 4) {
+        _ST_UPLOAD_ENTRY(0);
+        _ST_UPLOAD_ENTRY(1);
+        _ST_UPLOAD_ENTRY(2);
+        _ST_UPLOAD_ENTRY(3);
+        return 4;
+    }
+#endif
+
     for (Y = 0; Y != len2; Y++) {
         tmp = Y;
-        Y = sptr[Y];
+        tile = sptr[Y];
+#ifdef SPARSE_TILING_VMEM_ANIMATION
+        // Current frame of animated tiles
+        for (X = _st_anim_nb - 1; X >= 0; X--) {
+            if ((tile & 0xfe) == _st_anim_tile[X]) {
+                tile += _st_anim_offset[X];
+                break;
+            }
+        }
+#endif
+        Y = tile;
         mirroring = Y & 1;
         if (mirroring) { 
             // Vertical mirroring)
@@ -149,67 +877,20 @@ char _sparse_tiling_ROM_to_RAM(char *sptr, char w, char mode)
         Y++;
         for (X = 1; X >= 0; X--) {
             
-            vtmp[0] = chptr0[Y];
-            vtmp[1] = chptr1[Y];
-            vtmp[2] = chptr2[Y];
-            vtmp[3] = chptr3[Y];
-            vtmp[4] = chptr4[Y];
-            vtmp[5] = chptr5[Y];
-            vtmp[6] = chptr6[Y];
-            vtmp[7] = chptr7[Y];
-            vtmp[8] = chptr8[Y];
-            vtmp[9] = chptr9[Y];
-            vtmp[10] = chptr10[Y];
-            vtmp[11] = chptr11[Y];
-            vtmp[12] = chptr12[Y];
-            vtmp[13] = chptr13[Y];
-            vtmp[14] = chptr14[Y];
-            vtmp[15] = chptr15[Y];
+            _ST_LOAD_COLUMN();
             Y = tmp << 1;
             if (X) Y++;
 
             if (mirroring) {
-                vmemptr0[Y] = vtmp[15];
-                vmemptr1[Y] = vtmp[14];
-                vmemptr2[Y] = vtmp[13];
-                vmemptr3[Y] = vtmp[12];
-                vmemptr4[Y] = vtmp[11];
-                vmemptr5[Y] = vtmp[10];
-                vmemptr6[Y] = vtmp[9];
-                vmemptr7[Y] = vtmp[8];
-                vmemptr8[Y] = vtmp[7];
-                vmemptr9[Y] = vtmp[6];
-                vmemptr10[Y] = vtmp[5];
-                vmemptr11[Y] = vtmp[4];
-                vmemptr12[Y] = vtmp[3];
-                vmemptr13[Y] = vtmp[2];
-                vmemptr14[Y] = vtmp[1];
-                vmemptr15[Y] = vtmp[0];
+                _ST_STORE_COLUMN_MIRRORED();
                 if (X) {
-                    Y = tmp;
-                    Y = sptr[Y];
+                    Y = tile;
                     Y--;
                 }
             } else {
-                vmemptr0[Y] = vtmp[0];
-                vmemptr1[Y] = vtmp[1];
-                vmemptr2[Y] = vtmp[2];
-                vmemptr3[Y] = vtmp[3];
-                vmemptr4[Y] = vtmp[4];
-                vmemptr5[Y] = vtmp[5];
-                vmemptr6[Y] = vtmp[6];
-                vmemptr7[Y] = vtmp[7];
-                vmemptr8[Y] = vtmp[8];
-                vmemptr9[Y] = vtmp[9];
-                vmemptr10[Y] = vtmp[10];
-                vmemptr11[Y] = vtmp[11];
-                vmemptr12[Y] = vtmp[12];
-                vmemptr13[Y] = vtmp[13];
-                vmemptr14[Y] = vtmp[14];
-                vmemptr15[Y] = vtmp[15];
+                _ST_STORE_COLUMN();
                 if (X) {
-                    Y = tmp;
-                    Y = sptr[Y];
+                    Y = tile;
                 }
             }
         }
@@ -218,30 +899,188 @@ char _sparse_tiling_ROM_to_RAM(char *sptr, char w, char mode)
     return len2;
 }
 
+// Gets the vmem copy of a tileset, uploading it if it's not in the cache.
+// Returns the number of transferred entries, and leaves the vmem address in _sparse_tiling_vmem_ptr_low/high
+// and the cache entry in _st_cache_entry (0xff if the tileset couldn't be stored)
+char _sparse_tiling_vmem_get(char *sptr, char w, char mode)
+{
+    char low, high, age, oldest = 0, victim = 0xff;
+    // 2 bytes per entry, 2 entries per tile in 160B
+    if (((mode)?(w << 2):(w << 1)) > SPARSE_TILING_VMEM_SLOT_SIZE) {
+        _ms_dmaerror++;
+        _st_cache_entry = 0xff;
+        return 0;
+    }
+    low = sptr;
+    high = sptr >> 8;
+    for (X = _ST_CACHE_SIZE - 1; X >= 0; X--) {
+        if (_st_cache_rom_low[X] == low && _st_cache_rom_high[X] == high) {
+            // Cache hit
+            _st_cache_age[X] = _st_cache_clock;
+            _st_cache_entry = X;
+            _sparse_tiling_vmem_ptr_low = _st_cache_vmem_low[X];
+            _sparse_tiling_vmem_ptr_high = _st_cache_vmem_high[X];
+#ifdef SPARSE_TILING_VMEM_ANIMATION
+            // An unused slot is skipped by the refresh sweep: bring it up to date before showing it again
+            if (!_st_cache_refcount[X] && _st_cache_stamp[X] != _st_anim_stamp) {
+                _st_cache_refcount[X]++;
+                _st_cache_stamp[X] = _st_anim_stamp;
+                return _sparse_tiling_ROM_to_RAM(sptr, w, mode);
+            }
+#endif
+            _st_cache_refcount[X]++;
+            return 0;
+        }
+    }
+    // Evict the least recently used free entry. Entries still shown by a DL are never evicted
+    for (X = _ST_CACHE_SIZE - 1; X >= 0; X--) {
+        if (!_st_cache_refcount[X]) {
+            age = _st_cache_clock - _st_cache_age[X];
+            if (age >= oldest) {
+                oldest = age;
+                victim = X;
+            }
+        }
+    }
+    if (victim == 0xff) { // The cache is too small
+        _ms_dmaerror++;
+        _st_cache_entry = 0xff;
+        return 0;
+    }
+    X = victim;
+    _st_cache_rom_low[X] = low;
+    _st_cache_rom_high[X] = high;
+    _st_cache_refcount[X]++;
+    _st_cache_age[X] = _st_cache_clock;
+    _st_cache_entry = X;
+#ifdef SPARSE_TILING_VMEM_ANIMATION
+    _st_cache_w[X] = w;
+    _st_cache_mode[X] = mode;
+    _st_cache_stamp[X] = _st_anim_stamp;
+#endif
+    _sparse_tiling_vmem_ptr_low = _st_cache_vmem_low[X];
+    _sparse_tiling_vmem_ptr_high = _st_cache_vmem_high[X];
+    return _sparse_tiling_ROM_to_RAM(sptr, w, mode);
+}
+
+#ifdef SPARSE_TILING_VMEM_ANIMATION
+// Steps the animated tiles. To be called once per frame: when a tile changes, the vmem slots in use are
+// checked for animated tiles and uploaded again, a few slots per frame (within SPARSE_TILING_ANIM_BUDGET)
+void sparse_tiling_animate()
+{
+    char *sptr, len2, slot, tile, found;
+    for (X = _st_anim_nb - 1; X >= 0; X--) {
+        _st_anim_counter[X]--;
+        if (!_st_anim_counter[X]) {
+            _st_anim_counter[X] = _st_anim_period[X];
+            if (_st_anim_offset[X] == _st_anim_last[X]) {
+                _st_anim_offset[X] = 0;
+            } else {
+                _st_anim_offset[X] += 2;
+            }
+            _st_anim_stamp++;
+            _st_anim_pending = _ST_CACHE_SIZE; // One more round from the cursor (the sweep goes on, it doesn't restart)
+        }
+    }
+    *TIM64T = SPARSE_TILING_ANIM_BUDGET;
+    while (_st_anim_pending && !(*TIMINT & 0x80) && *INTIM >= SPARSE_TILING_ANIM_SLOT_COST) {
+        _st_anim_pending--;
+        X = _st_anim_cursor;
+        if (!X) X = _ST_CACHE_SIZE;
+        X--;
+        _st_anim_cursor = X;
+        slot = X;
+        if (_st_cache_refcount[X] && _st_cache_stamp[X] != _st_anim_stamp) {
+            _st_cache_stamp[X] = _st_anim_stamp;
+            sptr = _st_cache_rom_low[X] | (_st_cache_rom_high[X] << 8);
+            len2 = (_st_cache_mode[X])?(_st_cache_w[X] << 1):_st_cache_w[X];
+            // Only the slots using animated tiles are uploaded again
+            found = 0;
+            for (Y = 0; Y != len2; Y++) {
+                tile = sptr[Y] & 0xfe;
+                for (X = _st_anim_nb - 1; X >= 0; X--) {
+                    if (tile == _st_anim_tile[X]) found = 1;
+                }
+            }
+            if (found) {
+                X = slot;
+                _sparse_tiling_vmem_ptr_low = _st_cache_vmem_low[X];
+                _sparse_tiling_vmem_ptr_high = _st_cache_vmem_high[X];
+                _sparse_tiling_ROM_to_RAM(sptr, _st_cache_w[X], _st_cache_mode[X]);
+            }
+        }
+    }
+}
+#endif
+
+// Gets the vmem copy of the tileset for this line, and records its cache entry in the line references.
+// _st_cache_entry is 0xff if it can't be displayed (no room left in the line references or in the cache)
+#define _sparse_tiling_line_vmem_get() \
+    if (nb_entries == _ST_LINE_ENTRIES_MAX) { \
+        _ms_dmaerror++; \
+        _st_cache_entry = 0xff; \
+    } else { \
+        total_transfered += _sparse_tiling_vmem_get(tmpptr, w, mode); \
+        if (_st_cache_entry != 0xff) { \
+            X = entries_idx + nb_entries; \
+            _st_line_entries[X] = _st_cache_entry; \
+            nb_entries++; \
+        } \
+    }
+
+// Releases the tilesets referenced by the zone DL zb (zone + SPARSE_TILING_SCROLLING_ZONE for buffer 1),
+// before it is rebuilt. The other buffer keeps its own references
+void _sparse_tiling_vmem_release(char zb)
+{
+    char entries_idx;
+    Y = zb;
+    entries_idx = _st_line_entries_idx[Y];
+    _ms_tmp = entries_idx + _st_line_nb_entries[Y];
+    _st_line_nb_entries[Y] = 0;
+    for (X = entries_idx; X != _ms_tmp; X++) {
+        Y = _st_line_entries[X];
+        _st_cache_refcount[Y]--;
+    }
+    _st_cache_clock++;
+}
+
 char _sparse_tiling_load_line(signed char y)
 {
     char *ptr, data[5];
     char *tmpptr, x, linedl, txpos, xoffset;
     signed char right, r, d;
-    char st_idata_idx, st_idata_size;
-    char tileset_counter = 0;
+    char entries_idx, nb_entries, zb;
     char mode, w;
     char total_transfered = 0;
      
+#ifdef SPARSE_TILING_SEGMENTS
+    _sparse_tiling_segment_check(y);
+#endif
     if (_ms_buffer) {
-        X = y + SPARSE_TILING_SCROLLING_ZONE;
-        linedl = y + _MS_DLL_ARRAY_SIZE;
+        X = y + _ST_LINES;
+        linedl = _ST_ZONE(y) + _MS_DLL_ARRAY_SIZE;
+        zb = _ST_ZONE(y) + SPARSE_TILING_SCROLLING_ZONE; // This zone in this buffer
     } else {
         X = y;
-        linedl = y;
+        linedl = _ST_ZONE(y);
+        zb = linedl;
     }
+#ifdef SPARSE_TILING_RING
+    _st_ring_dirty[X] = 0;
+#endif
     txpos = _tiling_xpos[X]; 
     xoffset = _tiling_xoffset[X]; 
     right = txpos + 22;
+#ifdef SPARSE_TILING_BIDIRECTIONAL
+    _sparse_tiling_step_back(y, txpos);
+#endif
     Y = y;
     ptr = _tiling_ptr[Y];
-    st_idata_idx = _st_idata_idx[Y];
-    st_idata_size = _st_idata_size[Y];
+#ifndef SPARSE_TILING_LAYERS
+    _sparse_tiling_vmem_release(zb); // Release the tilesets used by the previous version of this line (layers: by _sparse_tiling_load_zone)
+#endif
+    entries_idx = _st_line_entries_idx[Y = zb];
+    nb_entries = _st_line_nb_entries[Y]; // After the lower layers' ones
     _ms_tmpptr = _ms_dls[X = linedl];
     // Find the first visible tileset on this line, if any
     Y = 0;
@@ -251,9 +1090,21 @@ char _sparse_tiling_load_line(signed char y)
         if (w == 96) {
             if (ptr[++Y] == 0xff) {
                 // Finished
+#if defined(SPARSE_TILING_BIDIRECTIONAL) || defined(SPARSE_TILING_RING)
+                Y--;
+                _tiling_ptr[X = y] = ptr + Y; // Stay on the end of this line, so that we can step back (or go on with appended tilesets) from there
+#endif
+#ifdef SPARSE_TILING_LAYERS
+                _ms_dlend_save_overlay[Y = linedl] = _ms_dlend[Y]; // Nothing appended to the lower layers
+                X = y;
+#else
                 _ms_dlend[Y = linedl] = _ms_dlend_save[X = y];
                 _ms_dlend_save_overlay[Y] = _ms_dlend_save[X];
+#endif
+#if !defined(SPARSE_TILING_BIDIRECTIONAL) && !defined(SPARSE_TILING_RING)
                 _tiling_ptr[X] = _sparse_tiling_end_of_tileset; // To make sure this one is in bank0
+#endif
+                _st_line_nb_entries[X = zb] = nb_entries;
                 return 0;
             } else Y--;
         }
@@ -261,20 +1112,17 @@ char _sparse_tiling_load_line(signed char y)
         if (r >= 0) break;
         // Go to next tileset
         Y += _STS_SIZE;
-        // Remove it from video memory
-        _ms_tmp = st_idata_idx + st_idata_size;
-        for (X = st_idata_idx; X != _ms_tmp; X++) {
-            tmpptr = _st_idata[++X];
-            _st_idata[--X] = tmpptr;
-        }
-        if (st_idata_size) st_idata_size--;
     } while (1);
     X = y; 
     if (Y) { // Update the pointer
         _tiling_ptr[X] += Y;
     }
     Y++; // Next byte
+#ifdef SPARSE_TILING_LAYERS
+    x = _ms_dlend[X = linedl]; // Append to the lower layers
+#else
     x = _ms_dlend_save[X];
+#endif
     data[4] = ptr[Y];
     w = w - data[4] + 1;
     // First one: maybe is this too much on the left ?
@@ -283,58 +1131,45 @@ char _sparse_tiling_load_line(signed char y)
         
         signed char xpos = data[4] - txpos;
         
-        // Is it already transferred to video memory ?
-        if (st_idata_size) {
-            // Yes. Let's get the matching pointer
-            _save_y = Y;
-            Y = st_idata_idx;
-            tmpptr = _st_idata[Y];
-            Y = _save_y;
-            data[0] = tmpptr; ++Y;
-            data[1] = ptr[++Y] & 0xc0; // Remove immediate mode bit
-            mode = data[1] & 0x80;
-            data[2] = tmpptr >> 8; ++Y;
+        // Get it from the video memory cache (uploaded if needed)
+        data[0] = ptr[++Y]; 
+        data[1] = ptr[++Y] & 0xc0; // Remove immediate mode bit
+        mode = data[1] & 0x80;
+        tmpptr = data[0] | (ptr[++Y] << 8);
+        _save_y = Y;
+        _sparse_tiling_line_vmem_get();
+        data[0] = _sparse_tiling_vmem_ptr_low;
+        data[2] = _sparse_tiling_vmem_ptr_high;
+        Y = _save_y;
+
+        if (_st_cache_entry == 0xff) { // Not displayed
+            Y += 2;
         } else {
-            // Let's transfer from ROM to RAM
-            data[0] = ptr[++Y]; 
-            data[1] = ptr[++Y] & 0xc0; // Remove immediate mode bit
-            mode = data[1] & 0x80;
-            tmpptr = data[0] | (ptr[++Y] << 8);
-            // Store the pointer for this tileset_counter
+            if (xpos < 0) { // Reduce the length of this tileset so that is doesn't get out of screen on the left
+                w += xpos;
+                xpos = (mode)?(xpos << 2):(xpos << 1); 
+                // Advance pointer
+                if (data[0] >= xpos) data[2]++;
+                data[0] -= xpos;
+                xpos = 0;
+            } else if (r >= 24) { // Reduce the length of this tileset so that it doesn't get out of screen on the right
+                w -= (r - 24); 
+            }
+            data[3] = ptr[++Y];
+            w = (mode)?(w << 2):(w << 1); 
+
+            ++Y;
             _save_y = Y;
-            total_transfered += _sparse_tiling_ROM_to_RAM(tmpptr, w, mode);
-            data[0] = _sparse_tiling_vmem_ptr_low;
-            data[2] = _sparse_tiling_vmem_ptr_high;
-            Y = st_idata_idx;
-            _st_idata[Y] = _sparse_tiling_vmem_ptr_low | (_sparse_tiling_vmem_ptr_high << 8);
-            st_idata_size = 1;
+            Y = x; // 6 cycles
+            _ms_tmpptr[Y++] = data[0]; // 11 cycles
+            _ms_tmpptr[Y++] = data[1];
+            _ms_tmpptr[Y++] = data[2];
+            _ms_tmpptr[Y++] = ((-w) & 0x1f) | (data[3] & 0xe0);
+            _ms_tmpptr[Y++] = (xpos << 3) - xoffset;
+            x = Y; // 21 cycles
             Y = _save_y;
         }
 
-        if (xpos < 0) { // Reduce the length of this tileset so that is doesn't get out of screen on the left
-            w += xpos;
-            xpos = (mode)?(xpos << 2):(xpos << 1); 
-            // Advance pointer
-            if (data[0] >= xpos) data[2]++;
-            data[0] -= xpos;
-            xpos = 0;
-        } else if (r >= 24) { // Reduce the length of this tileset so that it doesn't get out of screen on the right
-            w -= (r - 24); 
-        }
-        data[3] = ptr[++Y];
-        w = (mode)?(w << 2):(w << 1); 
-
-        ++Y;
-        _save_y = Y;
-        Y = x; // 6 cycles
-        _ms_tmpptr[Y++] = data[0]; // 11 cycles
-        _ms_tmpptr[Y++] = data[1];
-        _ms_tmpptr[Y++] = data[2];
-        _ms_tmpptr[Y++] = ((-w) & 0x1f) | (data[3] & 0xe0);
-        _ms_tmpptr[Y++] = (xpos << 3) - xoffset;
-        x = Y; // 21 cycles
-        Y = _save_y;
-
         r = ptr[++Y];
         data[4] = ptr[++Y];
         w = r - data[4] + 1;
@@ -344,54 +1179,40 @@ char _sparse_tiling_load_line(signed char y)
             // Check termination
             if (r == 96 && data[4] == 0xff) break;
             
-            tileset_counter++;
             r -= txpos;
 
-            // Is it already transferred to video memory ?
-            if (tileset_counter < st_idata_size) {
-                // Yes. Let's get the matching pointer
-                _save_y = Y;
-                Y = st_idata_idx + tileset_counter;
-                tmpptr = _st_idata[Y];
-                Y = _save_y;
-                data[0] = tmpptr; ++Y;
-                data[1] = ptr[++Y] & 0xc0; // Remove immediate mode bit
-                mode = data[1] & 0x80;
-                data[2] = tmpptr >> 8; ++Y;
+            // Get it from the video memory cache (uploaded if needed)
+            data[0] = ptr[++Y]; 
+            data[1] = ptr[++Y] & 0xc0; // Remove immediate mode bit
+            mode = data[1] & 0x80;
+            tmpptr = data[0] | (ptr[++Y] << 8);
+            _save_y = Y;
+            _sparse_tiling_line_vmem_get();
+            data[0] = _sparse_tiling_vmem_ptr_low;
+            data[2] = _sparse_tiling_vmem_ptr_high;
+            Y = _save_y;
+
+            if (_st_cache_entry == 0xff) { // Not displayed
+                Y += 2;
             } else {
-                // Let's transfer from ROM to RAM
-                data[0] = ptr[++Y]; 
-                data[1] = ptr[++Y] & 0xc0; // Remove immediate mode bit
-                mode = data[1] & 0x80;
-                tmpptr = data[0] | (ptr[++Y] << 8);
-                // Store the pointer for this tileset_counter
+                if (r >= 24) { // Reduce the length of this tileset so that it doesn't get out of screen on the right
+                    w -= (r - 24); 
+                }
+                data[3] = ptr[++Y];
+                w = (mode)?(w << 2):(w << 1); 
+
+                ++Y;
                 _save_y = Y;
-                total_transfered += _sparse_tiling_ROM_to_RAM(tmpptr, w, mode);
-                data[0] = _sparse_tiling_vmem_ptr_low;
-                data[2] = _sparse_tiling_vmem_ptr_high;
-                Y = st_idata_idx + tileset_counter;
-                _st_idata[Y] = _sparse_tiling_vmem_ptr_low | (_sparse_tiling_vmem_ptr_high << 8);
-                st_idata_size++;
+                Y = x; // 6 cycles
+                _ms_tmpptr[Y++] = data[0]; // 11 cycles
+                _ms_tmpptr[Y++] = data[1];
+                _ms_tmpptr[Y++] = data[2];
+                _ms_tmpptr[Y++] = ((-w) & 0x1f) | (data[3] & 0xe0);
+                _ms_tmpptr[Y++] = ((data[4] - txpos) << 3) - xoffset;
+                x = Y; // 21 cycles
                 Y = _save_y;
             }
 
-            if (r >= 24) { // Reduce the length of this tileset so that it doesn't get out of screen on the right
-                w -= (r - 24); 
-            }
-            data[3] = ptr[++Y];
-            w = (mode)?(w << 2):(w << 1); 
-
-            ++Y;
-            _save_y = Y;
-            Y = x; // 6 cycles
-            _ms_tmpptr[Y++] = data[0]; // 11 cycles
-            _ms_tmpptr[Y++] = data[1];
-            _ms_tmpptr[Y++] = data[2];
-            _ms_tmpptr[Y++] = ((-w) & 0x1f) | (data[3] & 0xe0);
-            _ms_tmpptr[Y++] = ((data[4] - txpos) << 3) - xoffset;
-            x = Y; // 21 cycles
-            Y = _save_y;
-
             r = ptr[++Y];
             data[4] = ptr[++Y];
             w = r - data[4] + 1;
@@ -400,9 +1221,86 @@ char _sparse_tiling_load_line(signed char y)
     } 
     _ms_dlend[X = linedl] = x;
     _ms_dlend_save_overlay[X] = x;
-    _st_idata_size[Y = y] = st_idata_size; // Store the updated immediate data size
+    _st_line_nb_entries[Y = zb] = nb_entries; // Store the cache entries now referenced by this zone in this buffer
     return total_transfered;
 }
+#elif defined(SPARSE_TILING_SOA)
+char _sparse_tiling_load_line(signed char y)
+{
+    char *ptr, *tend, *tstart, *tlow, *tmode, *thigh, *tpw, *tdma, data[4];
+    char x, i, n, linedl, txpos, xoffset;
+    signed char r, xpos;
+ 
+#ifdef SPARSE_TILING_SEGMENTS
+    _sparse_tiling_segment_check(y);
+#endif
+    if (_ms_buffer) {
+        X = y + SPARSE_TILING_SCROLLING_ZONE;
+        linedl = y + _MS_DLL_ARRAY_SIZE;
+    } else {
+        X = y;
+        linedl = y;
+    }
+    txpos = _tiling_xpos[X]; 
+    xoffset = _tiling_xoffset[X]; 
+    ptr = _tiling_ptr[Y = y];
+    _sparse_tiling_soa_arrays(ptr);
+    X = y;
+    Y = _tiling_idx[X];
+#ifdef SPARSE_TILING_BIDIRECTIONAL
+    // Step back over the tilesets that came back in view
+    while (Y) {
+        Y--;
+        r = tend[Y] - txpos;
+        if (r < 0) {
+            Y++;
+            break;
+        }
+    }
+#endif
+    // Find the first visible tileset on this line, if any
+    while (Y != n) {
+        r = tend[Y] - txpos;
+        if (r >= 0) break;
+        Y++;
+    }
+    _tiling_idx[X] = Y;
+    x = _ms_dlend_save[X];
+    _ms_tmpptr = _ms_dls[X = linedl];
+    for (i = Y; i != n; i++) {
+        Y = i;
+        xpos = tstart[Y] - txpos;
+        if (xpos > 22) break;
+        r = tend[Y] - txpos;
+        data[0] = tlow[Y];
+        data[1] = tmode[Y];
+        data[2] = thigh[Y];
+        data[3] = tpw[Y];
+        if (xpos < 0) { // Reduce the length of this tileset so that is doesn't get out of screen on the left
+            data[3] = (((data[3] | 0xe0) - xpos) & 0x1f) | (data[3] & 0xe0); 
+            // Advance pointer
+            if (data[0] >= xpos) data[2]++;
+            data[0] -= xpos;
+            xpos = 0;
+        }
+        if (r >= 24) { // Reduce the length of this tileset so that it doesn't get out of screen on the right
+            data[3] = ((xpos - 23) & 0x1f) | (data[3] & 0xe0); 
+        } 
+#ifdef DMA_CHECK 
+        _ms_dldma[X] -= tdma[Y];
+#endif
+        Y = x;
+        _ms_tmpptr[Y++] = data[0];
+        _ms_tmpptr[Y++] = data[1];
+        _ms_tmpptr[Y++] = data[2];
+        _ms_tmpptr[Y++] = data[3];
+        _ms_tmpptr[Y++] = (xpos << 3) - xoffset;
+        x = Y;
+    } 
+    _ms_dlend[X] = x;
+    _ms_dlend_save_overlay[X] = x;
+    return 0;
+}
 #else
 char _sparse_tiling_load_line(signed char y)
 {
@@ -410,16 +1308,25 @@ char _sparse_tiling_load_line(signed char y)
     char x, linedl, txpos, xoffset;
     signed char right, r, d;
  
+#ifdef SPARSE_TILING_SEGMENTS
+    _sparse_tiling_segment_check(y);
+#endif
     if (_ms_buffer) {
-        X = y + SPARSE_TILING_SCROLLING_ZONE;
-        linedl = y + _MS_DLL_ARRAY_SIZE;
+        X = y + _ST_LINES;
+        linedl = _ST_ZONE(y) + _MS_DLL_ARRAY_SIZE;
     } else {
         X = y;
-        linedl = y;
+        linedl = _ST_ZONE(y);
     }
+#ifdef SPARSE_TILING_RING
+    _st_ring_dirty[X] = 0;
+#endif
     txpos = _tiling_xpos[X]; 
     xoffset = _tiling_xoffset[X]; 
     right = txpos + 22;
+#ifdef SPARSE_TILING_BIDIRECTIONAL
+    _sparse_tiling_step_back(y, txpos);
+#endif
     ptr = _tiling_ptr[Y = y];
     _ms_tmpptr = _ms_dls[X = linedl];
     // Find the first visible tileset on this line, if any
@@ -429,9 +1336,20 @@ char _sparse_tiling_load_line(signed char y)
         if (ptr[Y] == 96) {
             if (ptr[++Y] == 0xff) {
                 // Finished
+#if defined(SPARSE_TILING_BIDIRECTIONAL) || defined(SPARSE_TILING_RING)
+                Y--;
+                _tiling_ptr[X = y] = ptr + Y; // Stay on the end of this line, so that we can step back (or go on with appended tilesets) from there
+#endif
+#ifdef SPARSE_TILING_LAYERS
+                _ms_dlend_save_overlay[Y = linedl] = _ms_dlend[Y]; // Nothing appended to the lower layers
+                X = y;
+#else
                 _ms_dlend[Y = linedl] = _ms_dlend_save[X = y];
                 _ms_dlend_save_overlay[Y] = _ms_dlend_save[X];
+#endif
+#if !defined(SPARSE_TILING_BIDIRECTIONAL) && !defined(SPARSE_TILING_RING)
                 _tiling_ptr[X] = _sparse_tiling_end_of_tileset; // To make sure this one is in bank0
+#endif
                 return 0;
             } else Y--;
         }
@@ -444,7 +1362,11 @@ char _sparse_tiling_load_line(signed char y)
         _tiling_ptr[X] += Y;
     }
     Y++; // Next byte
+#ifdef SPARSE_TILING_LAYERS
+    x = _ms_dlend[X = linedl]; // Append to the lower layers
+#else
     x = _ms_dlend_save[X];
+#endif
     data[4] = ptr[Y];
     // First one: maybe is this too much on the left ?
     d = right - data[4];
@@ -522,21 +1444,91 @@ char _sparse_tiling_load_line(signed char y)
 }
 #endif
 
+#ifdef SPARSE_TILING_LAYERS
+// Reloads all the layers of zone y, back to front
+char _sparse_tiling_load_zone(signed char y)
+{
+    char v, l, linedl, total_transfered = 0;
+    linedl = (_ms_buffer)?y + _MS_DLL_ARRAY_SIZE:y;
+#ifdef MULTISPRITE_USE_VIDEO_MEMORY
+    _sparse_tiling_vmem_release((_ms_buffer)?y + SPARSE_TILING_SCROLLING_ZONE:y);
+#endif
+    _ms_dlend[X = linedl] = _ms_dlend_save[Y = y];
+    v = y;
+    for (l = 0; l != SPARSE_TILING_LAYERS; l++, v += SPARSE_TILING_SCROLLING_ZONE) {
+        total_transfered += _sparse_tiling_load_line(v);
+        X = (_ms_buffer)?v + _ST_LINES:v;
+        _st_layer_end[X] = _ms_dlend[Y = linedl];
+    }
+    return total_transfered;
+}
+#endif
+
+#ifdef SPARSE_TILING_SOA
+char sparse_tiling_collision(char top, char left, char right)
+{
+    char *ptr, *tend, *tstart, *tlow, *tmode, *thigh, *tpw, *tdma, *ptr_tiles;
+    char intersect = -1, n, i, c, lc, rc, txpos, xoffset;
+    char y = top >> 4;
+    if (_ms_buffer) {
+        X = y + SPARSE_TILING_SCROLLING_ZONE;
+    } else {
+        X = y;
+    }
+    txpos = _tiling_xpos[X]; 
+    xoffset = _tiling_xoffset[X]; 
+    // Columns of the tilemap covered by [left, right]
+    lc = txpos + ((left + xoffset) >> 3);
+    rc = txpos + ((right + xoffset) >> 3);
+    ptr = _tiling_ptr[Y = y];
+    _sparse_tiling_soa_arrays(ptr);
+    // Start from the first visible tileset on this line
+    for (i = _tiling_idx[X = y]; i != n; i++) {
+        Y = i;
+        if (tend[Y] >= lc) {
+            c = tstart[Y];
+            if (c > rc) break;
+            ptr_tiles = tlow[Y] | (thigh[Y] << 8);
+            // Scan the overlapping columns of this tileset
+            X = ((lc > c)?lc:c) - c;
+            c = ((rc < tend[Y])?rc:tend[Y]) - c;
+            for (Y = X; Y <= c; Y++) {
+                if (ptr_tiles[Y] < intersect) intersect = ptr_tiles[Y];    
+            }
+        }
+    }
+    return intersect;
+}
+#else
 char sparse_tiling_collision(char top, char left, char right)
 {
     char *ptr, intersect = -1, start, end, txpos, xoffset;
+#ifdef SPARSE_TILING_COLUMN_INDEX
+    char *idx;
+#endif
     signed char xrc;
     char lc = left >> 3;
     char rc = right >> 3;
     char y = top >> 4;
+#ifdef SPARSE_TILING_LAYERS
+    y += (SPARSE_TILING_LAYERS - 1) * SPARSE_TILING_SCROLLING_ZONE; // Collisions are with the front layer
+#endif
     if (_ms_buffer) {
-        X = y + SPARSE_TILING_SCROLLING_ZONE;
+        X = y + _ST_LINES;
     } else {
         X = y;
     }
     txpos = _tiling_xpos[X]; 
     xoffset = _tiling_xoffset[X]; 
+#ifdef SPARSE_TILING_COLUMN_INDEX
+    // Jump close to the first possibly intersecting tileset, using the column index
+    Y = y;
+    ptr = _ms_sparse_tiles_ptr_low[Y] | (_ms_sparse_tiles_ptr_high[Y] << 8);
+    idx = _ms_sparse_index_ptr_low[Y] | (_ms_sparse_index_ptr_high[Y] << 8);
+    ptr += idx[Y = (txpos + lc) >> 3];
+#else
     ptr = _tiling_ptr[Y = y];
+#endif
     // Find the first possibly intersecting tileset on this line
     Y = 0;
     do {
@@ -589,21 +1581,388 @@ char sparse_tiling_collision(char top, char left, char right)
     }
     return intersect;
 }
+#endif
+
+ramchip char _sparse_tiling_sweep_tile;
+
+// Tile hit by the last sparse_tiling_sweep (-1 if none)
+#define sparse_tiling_sweep_tile (_sparse_tiling_sweep_tile)
+
+// Swept collision, so that fast objects don't tunnel through thin platforms: moves the (x, y, w, h) box
+// by (dx, dy) pixels (-127 to 127) and returns the number of steps done before hitting a tile
+// (max(|dx|, |dy|) if none). Each time the leading edge of the box crosses a tile boundary, only the
+// entered column (one sparse_tiling_collision per line) or line is tested
+char sparse_tiling_sweep(char x, char y, char w, char h, signed char dx, signed char dy)
+{
+    char adx, ady, l, d, ex, ey, lx, ly, xo, z, t;
+    signed char sx, sy;
+    // Tile columns are aligned the same way on all the lines
+#ifdef SPARSE_TILING_LAYERS
+    X = (SPARSE_TILING_LAYERS - 1) * SPARSE_TILING_SCROLLING_ZONE;
+#else
+    X = 0;
+#endif
+    if (_ms_buffer) X += _ST_LINES;
+    xo = _tiling_xoffset[X] & 7;
+    if (dx < 0) { adx = -dx; sx = -1; lx = x; } else { adx = dx; sx = 1; lx = x + w - 1; }
+    if (dy < 0) { ady = -dy; sy = -1; ly = y; } else { ady = dy; sy = 1; ly = y + h - 1; }
+    l = (adx > ady)?adx:ady;
+    ex = l >> 1;
+    ey = ex;
+    t = -1;
+    for (d = 0; d != l; d++) {
+        ex += adx;
+        if (ex >= l) {
+            ex -= l;
+            z = (lx + xo) >> 3;
+            x += sx;
+            lx += sx;
+            if (((lx + xo) >> 3) != z) {
+                for (z = y >> 4; z <= ((y + h - 1) >> 4); z++) {
+                    if (z >= SPARSE_TILING_SCROLLING_ZONE) break;
+                    t = sparse_tiling_collision(z << 4, lx, lx);
+                    if (t != -1) break;
+                }
+                if (t != -1) break;
+            }
+        }
+        ey += ady;
+        if (ey >= l) {
+            ey -= l;
+            z = ly >> 4;
+            y += sy;
+            ly += sy;
+            if ((ly >> 4) != z && (ly >> 4) < SPARSE_TILING_SCROLLING_ZONE) {
+                t = sparse_tiling_collision(ly, x, x + w - 1);
+                if (t != -1) break;
+            }
+        }
+    }
+    _sparse_tiling_sweep_tile = t;
+    return d;
+}
+
+// Pixel accurate collision of the (x, y, w, h) box with the tiles, using the tile masks (see multisprite_tile_masks).
+// Returns the first tile hit, or -1 if none. The tile of each overlapped column is found with sparse_tiling_collision
+char sparse_tiling_collision_pixel(char x, char y, char w, char h)
+{
+    char mx, ex, ey, xo, i, j, l, r, t, b, px, tile;
+#ifdef SPARSE_TILING_LAYERS
+    X = (SPARSE_TILING_LAYERS - 1) * SPARSE_TILING_SCROLLING_ZONE;
+#else
+    X = 0;
+#endif
+    if (_ms_buffer) X += _ST_LINES;
+    xo = _tiling_xoffset[X] & 7;
+    mx = x + xo;
+    ex = mx + w - 1;
+    ey = y + h - 1;
+    for (j = y >> 4; j <= (ey >> 4); j++) {
+        if (j >= SPARSE_TILING_SCROLLING_ZONE) break;
+        t = (j == (y >> 4))?y & 15:0;
+        b = (j == (ey >> 4))?ey & 15:15;
+        for (i = mx >> 3; i <= (ex >> 3); i++) {
+            if (i == (mx >> 3)) {
+                l = mx & 7;
+                px = x;
+            } else {
+                l = 0;
+                px = (i << 3) - xo;
+            }
+            r = (i == (ex >> 3))?ex & 7:7;
+            tile = sparse_tiling_collision(j << 4, px, px);
+            if (tile != -1) {
+                if (_ms_tile_mask_box(tile, l, t, r, b)) return tile;
+            }
+        }
+    }
+    return -1;
+}
 
+#ifdef MULTISPRITE_USE_VIDEO_MEMORY
+// multisprite_save copies the DLs of this buffer to the other one: the other buffer takes the same cache references
+void _sparse_tiling_vmem_share()
+{
+    char y, src, dst, n, e;
+    for (y = 0; y != SPARSE_TILING_SCROLLING_ZONE; y++) {
+        if (_ms_buffer) {
+            src = y + SPARSE_TILING_SCROLLING_ZONE;
+            dst = y;
+        } else {
+            src = y;
+            dst = y + SPARSE_TILING_SCROLLING_ZONE;
+        }
+        _sparse_tiling_vmem_release(dst);
+        n = _st_line_nb_entries[X = src];
+        _st_line_nb_entries[X = dst] = n;
+        src = _st_line_entries_idx[X = src];
+        dst = _st_line_entries_idx[X = dst];
+        for (; n != 0; n--, src++, dst++) {
+            e = _st_line_entries[X = src];
+            _st_line_entries[X = dst] = e;
+            _st_cache_refcount[X = e]++;
+        }
+    }
+}
+#endif
+
+// To be called before multisprite_save, which copies the lines to the other buffer
 void sparse_tiling_display()
 { 
     signed char y;    
     for (y = SPARSE_TILING_SCROLLING_ZONE - 1; y >= 0; y--) { 
+#ifdef SPARSE_TILING_LAYERS
+        _sparse_tiling_load_zone(y); 
+#else
         _sparse_tiling_load_line(y); 
+#endif
     } 
+#ifdef MULTISPRITE_USE_VIDEO_MEMORY
+    _sparse_tiling_vmem_share();
+#endif
+}
+
+// Brings _tiling_xoffset[X] back in the [0, 16[ range, moving _tiling_xpos[X] by 2 tiles steps
+#ifdef SPARSE_TILING_BIDIRECTIONAL
+#define _sparse_tiling_realign() \
+    while (_tiling_xoffset[X] >= 16) { \
+        _tiling_xoffset[X] -= 16; \
+        _tiling_xpos[X] += 2; \
+    } \
+    while (_tiling_xoffset[X] < 0) { \
+        _tiling_xoffset[X] += 16; \
+        _tiling_xpos[X] -= 2; \
+    }
+#else
+#define _sparse_tiling_realign() \
+    while (_tiling_xoffset[X] >= 16) { \
+        _tiling_xoffset[X] -= 16; \
+        _tiling_xpos[X] += 2; \
+    }
+#endif
+
+#ifdef SPARSE_TILING_LAYERS
+// Computes the offset of each layer for this buffer (speed / 16 of offset, rounded towards 0).
+// Remainders are kept for the next frames
+void _sparse_tiling_layer_steps(_ST_OFFSET offset)
+{
+    signed char step, m;
+    char l, sp;
+    X = (_ms_buffer)?SPARSE_TILING_LAYERS:0;
+    for (l = 0; l != SPARSE_TILING_LAYERS; l++, X++) {
+        // acc += offset * speed, by shifts and adds
+        m = offset;
+        sp = _st_layer_speed[Y = l];
+        while (sp) {
+            if (sp & 1) _st_layer_acc[X] += m;
+            m <<= 1;
+            sp >>= 1;
+        }
+        step = _st_layer_acc[X];
+        step = (step < 0)?-((-step) >> 4):(step >> 4);
+        _st_layer_step[Y = l] = step;
+        _st_layer_acc[X] -= step << 4;
+    }
+}
+
+// Returns 1 if a layer of zone y (in this buffer) is out of the [0, 16[ offset range
+char _sparse_tiling_zone_out_of_range(char y)
+{
+    char l;
+    X = (_ms_buffer)?y + _ST_LINES:y;
+    for (l = 0; l != SPARSE_TILING_LAYERS; l++) {
+#ifdef SPARSE_TILING_BIDIRECTIONAL
+        if (_tiling_xoffset[X] >= 16 || _tiling_xoffset[X] < 0) return 1;
+#else
+        if (_tiling_xoffset[X] >= 16) return 1;
+#endif
+        X += SPARSE_TILING_SCROLLING_ZONE;
+    }
+    return 0;
+}
+
+// Moves the layers of zone y (in this buffer) by their step. Returns 1 if the zone must be reloaded
+char _sparse_tiling_zone_step(char y)
+{
+    char l;
+    X = (_ms_buffer)?y + _ST_LINES:y;
+    for (l = 0; l != SPARSE_TILING_LAYERS; l++) {
+        _tiling_xoffset[X] += _st_layer_step[Y = l];
+        X += SPARSE_TILING_SCROLLING_ZONE;
+    }
+    return _sparse_tiling_zone_out_of_range(y);
+}
+
+// Realigns the layers of zone y (in this buffer), and reloads them
+char _sparse_tiling_reload_zone(char y)
+{
+    char l;
+    X = (_ms_buffer)?y + _ST_LINES:y;
+    for (l = 0; l != SPARSE_TILING_LAYERS; l++) {
+#ifdef SPARSE_TILING_BIDIRECTIONAL
+        _sparse_tiling_realign();
+#else
+        if (_tiling_xoffset[X] >= 16) {
+            _sparse_tiling_realign();
+        }
+#endif
+        X += SPARSE_TILING_SCROLLING_ZONE;
+    }
+    return _sparse_tiling_load_zone(y);
+}
+
+// Applies the offset of each layer to its tilesets in zone y (in this buffer)
+void _sparse_tiling_shift_zone(char y)
+{
+    char v, l, end;
+    signed char step;
+    _ms_tmpptr = _ms_dls[X = (_ms_buffer)?y + _MS_DLL_ARRAY_SIZE:y];
+    Y = _ms_dlend_save[X = y]; 
+    v = (_ms_buffer)?y + _ST_LINES:y;
+    for (l = 0; l != SPARSE_TILING_LAYERS; l++, v += SPARSE_TILING_SCROLLING_ZONE) {
+        _save_y = Y;
+        step = _st_layer_step[Y = l];
+        end = _st_layer_end[X = v];
+        Y = _save_y;
+        while (Y < end) {
+            if ((_ms_tmpptr[++Y] & 0x1f) == 0) {
+                // This is an extended header
+                Y++;
+            }
+            Y++; Y++;
+            _ms_tmpptr[Y] -= step; 
+            Y++;
+        }
+    }
+}
+#endif
+
+#ifdef SPARSE_TILING_SCHEDULER
+// Line reloads are scheduled within a time budget, measured with the RIOT timer in TIM64T intervals (64 cycles each).
+// The lines that need a reload are served round robin, from where the previous frame of this buffer stopped, and
+// a reload is only started if the longest reload measured so far still fits. At least one line is reloaded per frame,
+// so a deferred line waits at most SPARSE_TILING_SCROLLING_ZONE frames of its buffer (keep offset small enough for
+// its xoffset, a signed char, not to overflow meanwhile: offset * SPARSE_TILING_SCROLLING_ZONE < 112).
+void sparse_tiling_scroll(_ST_OFFSET offset)
+{
+    signed char y;
+#ifdef SPARSE_TILING_BIDIRECTIONAL
+    signed char u;
+#else
+    char u;
+#endif
+    char yy, linedl, xbase, n, t, b;
+
+    *TIM64T = _sparse_tiling_budget;
+
+    if (_ms_buffer) {
+        xbase = SPARSE_TILING_SCROLLING_ZONE;
+        yy = 2 * SPARSE_TILING_SCROLLING_ZONE - 1;
+        linedl = SPARSE_TILING_SCROLLING_ZONE - 1 + _MS_DLL_ARRAY_SIZE;
+    } else {
+        xbase = 0;
+        yy = SPARSE_TILING_SCROLLING_ZONE - 1;
+        linedl = SPARSE_TILING_SCROLLING_ZONE - 1;
+    }
+
+#ifdef SPARSE_TILING_LAYERS
+    // Apply the offset of each layer to all the zones. The reloaded ones will be rebuilt anyway
+    _sparse_tiling_layer_steps(offset);
+    for (y = SPARSE_TILING_SCROLLING_ZONE - 1; y >= 0; y--) {
+        _sparse_tiling_zone_step(y);
+        _sparse_tiling_shift_zone(y);
+    }
+#else
+    // Apply this offset to all the lines. The reloaded ones will be rebuilt anyway
+    for (y = SPARSE_TILING_SCROLLING_ZONE - 1; y >= 0; yy--, linedl--, y--) {
+        X = yy;
+        _tiling_xoffset[X] += offset;
+        _ms_tmpptr = _ms_dls[X = linedl];
+        Y = _ms_dlend_save[X = y]; 
+        X = linedl;
+        while (Y < _ms_dlend[X]) {
+            if ((_ms_tmpptr[++Y] & 0x1f) == 0) {
+                // This is an extended header
+                Y++;
+            }
+            Y++; Y++;
+            _ms_tmpptr[Y] -= offset; 
+            Y++;
+        }
+    }
+#endif
+
+    // Reload the lines (the zones with layers) out of the [0, 16[ offset range while there is time left
+    b = (_ms_buffer)?1:0;
+    y = _sparse_tiling_next[X = b];
+    for (n = SPARSE_TILING_SCROLLING_ZONE; n != 0; n--) {
+#ifdef SPARSE_TILING_LAYERS
+        if (_sparse_tiling_zone_out_of_range(y)) {
+            t = *INTIM;
+            _sparse_tiling_reload_zone(y);
+#else
+        X = xbase + y;
+        u = _tiling_xoffset[X];
+#ifdef SPARSE_TILING_BIDIRECTIONAL
+        if (u >= 16 || u < 0 || _ST_RING_DIRTY()) {
+#else
+        if (u >= 16 || _ST_RING_DIRTY()) {
+#endif
+            t = *INTIM;
+            _sparse_tiling_realign();
+            _sparse_tiling_load_line(y);
+#endif
+            if (*TIMINT & 0x80) break; // Out of budget
+            t -= *INTIM;
+            if (t > _sparse_tiling_line_cost) _sparse_tiling_line_cost = t;
+            if (*INTIM < _sparse_tiling_line_cost) break;
+        }
+        y++;
+        if (y == SPARSE_TILING_SCROLLING_ZONE) y = 0;
+    }
+    // The next frame of this buffer starts after the last reloaded line
+    if (n) {
+        y++;
+        if (y == SPARSE_TILING_SCROLLING_ZONE) y = 0;
+    }
+    _sparse_tiling_next[X = b] = y;
 }
+#elif defined(SPARSE_TILING_LAYERS)
+// All the layers of a zone are reloaded together, as one line of the reload budget. Otherwise, the DL entries
+// of each layer are shifted by the layer's own offset
+void sparse_tiling_scroll(_ST_OFFSET offset)
+{
+    signed char y;
+    char lines_moved = 0;
+    char total_transfered = 0;
+#ifdef SPARSE_TILING_BIDIRECTIONAL
+    char speed = (offset < 0)?-offset:offset;
+#else
+    char speed = offset;
+#endif
 
-void sparse_tiling_scroll(char offset)
+    _sparse_tiling_layer_steps(offset);
+    for (y = SPARSE_TILING_SCROLLING_ZONE - 1; y >= 0; y--) {
+        if (_sparse_tiling_zone_step(y) && speed >= lines_moved && total_transfered < 10) {
+            total_transfered += _sparse_tiling_reload_zone(y);
+            lines_moved++;
+        } else {
+            _sparse_tiling_shift_zone(y);
+        }
+    }
+}
+#else
+void sparse_tiling_scroll(_ST_OFFSET offset)
 {
     signed char y;
     char yy, linedl;
     char lines_moved = 0;
     char total_transfered = 0;
+#ifdef SPARSE_TILING_BIDIRECTIONAL
+    char speed = (offset < 0)?-offset:offset;
+#else
+    char speed = offset;
+#endif
     
     if (_ms_buffer) {
         yy = 2 * SPARSE_TILING_SCROLLING_ZONE - 1;
@@ -616,11 +1975,12 @@ void sparse_tiling_scroll(char offset)
     for (y = SPARSE_TILING_SCROLLING_ZONE - 1; y >= 0; yy--, linedl--, y--) {
         X = yy;
         _tiling_xoffset[X] += offset;
-        if (_tiling_xoffset[X] >= 16 && offset >= lines_moved && total_transfered < 10) {
-            do {
-                _tiling_xoffset[X] -= 16;
-                _tiling_xpos[X] += 2;
-            } while (_tiling_xoffset[X] >= 16);
+#ifdef SPARSE_TILING_BIDIRECTIONAL
+        if ((_tiling_xoffset[X] >= 16 || _tiling_xoffset[X] < 0 || _ST_RING_DIRTY()) && speed >= lines_moved && total_transfered < 10) {
+#else
+        if ((_tiling_xoffset[X] >= 16 || _ST_RING_DIRTY()) && speed >= lines_moved && total_transfered < 10) {
+#endif
+            _sparse_tiling_realign();
             total_transfered += _sparse_tiling_load_line(y);
             lines_moved++;
         } else {
@@ -640,17 +2000,244 @@ void sparse_tiling_scroll(char offset)
         }
     }
 }
+#endif
 
 #else
 #define VERTICAL_SCROLLING
+#ifdef SPARSE_TILING_8WAY
+#define MULTISPRITE_OVERLAY // Lines are rebuilt independently in each buffer
+#endif
 #include "multisprite.h"
 
 #define sparse_tiling_init(ptr) \
     _ms_sparse_tiles_ptr_high = ptr[Y = 0]; \
     _ms_sparse_tiles_ptr_low = ptr[Y = 1];
 
+#ifdef SPARSE_TILING_TEMPLATES
+#ifdef SPARSE_TILING_8WAY
+#error SPARSE_TILING_TEMPLATES is not supported with SPARSE_TILING_8WAY (lines are rebuilt at any column)
+#endif
+// Precompiled lines (see _ms_sparse_tiling_template). The whole line must fit in the 256 pixels X range
+#define sparse_tiling_init_templates(ptr) \
+    _ms_sparse_templates_ptr_high = ptr[Y = 0]; \
+    _ms_sparse_templates_ptr_low = ptr[Y = 1];
+#endif
+
 ramchip signed char _tiling_xpos, _tiling_ypos, _tiling_xoffset, _tiling_yoffset, _tiling_left, _tiling_right;
 
+#ifdef SPARSE_TILING_8WAY
+#ifdef MULTISPRITE_USE_VIDEO_MEMORY
+#error SPARSE_TILING_8WAY is not supported with MULTISPRITE_USE_VIDEO_MEMORY (lines show the ROM tilesets)
+#endif
+// 8-way scrolling. Each visible zone keeps its own horizontal state (in each buffer): the column its line was built from
+// and the current pixel offset from that column. A line is shifted in place while this offset stays in [0, 32[, and
+// rebuilt otherwise. Lines entering vertically are built in the scroll buffer at the current horizontal position.
+// Tiles must be the first objects of the zones (display the sprites after sparse_tiling_8way_scroll).
+// The camera column (_tiling_xpos) is taken as unsigned: maps can be up to 256 columns (2048 pixels) wide
+ramchip int _tiling_x, _tiling_y;
+ramchip signed char _tiling_zone_xpos[_MS_DLL_ARRAY_SIZE * 2], _tiling_zone_xoffset[_MS_DLL_ARRAY_SIZE * 2];
+ramchip char _tiling_row_dma;
+ramchip char _tiling_buffer_rebuild[2]; // All the lines of this buffer must be rebuilt (after a jump)
+
+#define _ST_8WAY_RIGHT 24 // Lines are built for columns [col - 2, col + 22]
+
+// Builds at _ms_tmpptr the DL entries of sparse line row, for columns [col - 2, col - 2 + _ST_8WAY_RIGHT] shifted by xoffset pixels.
+// col is the camera column, unsigned (maps can be up to 256 columns wide): the window tests are unsigned byte compares.
+// Returns the DL size, and leaves the DMA cost in _tiling_row_dma
+char _sparse_tiling_build_row(signed char row, char col, char xoffset)
+{
+    char *ptr, data[4], x = 0, end, start, tmp, left, right;
+    signed char r, xpos;
+
+    _tiling_row_dma = 0;
+    if (row < 0 || row >= TILING_HEIGHT) return 0;
+    left = (col >= 2)?col - 2:0;
+    right = col + (_ST_8WAY_RIGHT - 2);
+    if (right < col) right = 255;
+    Y = row;
+    ptr = _ms_sparse_tiles_ptr_low[Y] | (_ms_sparse_tiles_ptr_high[Y] << 8);   
+    Y = 0;
+    do {
+        end = ptr[Y];
+        start = ptr[++Y];
+        if (end == 96 && start == 0xff) break; // End of line
+        if (start > right) break; // This one and the next ones are on the right of the window
+        if (end < left) {
+            Y += _STS_SIZE - 1; // On the left of the window: next tileset
+        } else {
+            // Window relative positions: a visible tileset is at most 32 tiles long, so they fit in a signed char
+            xpos = start - col + 2;
+            r = end - col + 2;
+            data[0] = ptr[++Y];
+            data[1] = ptr[++Y];
+            data[2] = ptr[++Y];
+            data[3] = ptr[++Y];
+            if (xpos < 0) { // Reduce the length of this tileset so that is doesn't get out of the window on the left
+                data[3] = (((data[3] | 0xe0) - xpos) & 0x1f) | (data[3] & 0xe0); 
+                // Advance pointer
+                tmp = data[0] - xpos;
+                if (tmp < data[0]) data[2]++;
+                data[0] = tmp;
+                xpos = 0;
+            }
+            if (r > _ST_8WAY_RIGHT) { // Reduce the length of this tileset so that it doesn't get out of the window on the right
+                data[3] = ((xpos - (_ST_8WAY_RIGHT + 1)) & 0x1f) | (data[3] & 0xe0); 
+            }
+            _tiling_row_dma += ptr[++Y];
+            ++Y;
+            _save_y = Y;
+            Y = x;
+            _ms_tmpptr[Y++] = data[0];
+            _ms_tmpptr[Y++] = data[1];
+            _ms_tmpptr[Y++] = data[2];
+            _ms_tmpptr[Y++] = data[3];
+            _ms_tmpptr[Y++] = (xpos << 3) - xoffset;
+            x = Y;
+            Y = _save_y;
+        }
+    } while (1);
+    return x;
+}
+
+#define sparse_tiling_goto(x, y) \
+    _tiling_x = (x); \
+    _tiling_y = (y); \
+    _ms_tmp = x; \
+    _tiling_xpos = (((x) >> 8) << 5) | (_ms_tmp >> 3); \
+    _tiling_xoffset = (x) & 7; \
+    _ms_tmp = y; \
+    _tiling_ypos = ((((y) >> 8)) << 4) | (_ms_tmp >> 4); \
+    _tiling_yoffset = (y) & 0xf; \
+    _sparse_tiling_goto()
+
+// Rebuilds all the visible lines of the current buffer, starting at the current coarse offset
+void _sparse_tiling_goto()
+{
+    char size, bufoffset, zone, k;
+    signed char row, txpos, xoffset;
+
+    bufoffset = (_ms_buffer)?_MS_DLL_ARRAY_SIZE:0;
+    txpos = _tiling_xpos - 2;
+    xoffset = _tiling_xoffset + 16;
+    zone = _ms_vscroll_coarse_offset;
+    row = _tiling_ypos;
+    for (k = 0; k != _MS_NB_SCROLLING_ZONES + 1; k++, row++) {
+        _ms_tmpptr = _ms_dls[X = zone + bufoffset];
+        size = _sparse_tiling_build_row(row, _tiling_xpos, xoffset);
+        X = zone + bufoffset;
+        _ms_dlend[X] = size;
+        _ms_dlend_save_overlay[X] = size;
+#ifdef DMA_CHECK
+        _ms_dldma[X] = _MS_DMA_START_VALUE - _tiling_row_dma;
+        _ms_dldma_save_overlay[X] = _MS_DMA_START_VALUE - _tiling_row_dma;
+#endif
+        // Both buffers (multisprite_save copies this one to the other)
+        _tiling_zone_xpos[X] = txpos;
+        _tiling_zone_xoffset[X] = xoffset;
+        X = zone + (_MS_DLL_ARRAY_SIZE - bufoffset);
+        _tiling_zone_xpos[X] = txpos;
+        _tiling_zone_xoffset[X] = xoffset;
+        zone = (zone + 1) & 15;
+    }
+    _tiling_buffer_rebuild[X = 0] = 0;
+    _tiling_buffer_rebuild[++X] = 0;
+
+    _ms_vscroll_fine_offset = _tiling_yoffset;
+    _ms_vertical_scrolling_adjust_bottom_of_screen();
+}
+
+// Moves the camera to (x, y), in pixels. To be called once per frame, before displaying the sprites.
+// Horizontal steps can be of any size. Vertical steps of more than one line rebuild the whole screen
+void sparse_tiling_8way_scroll(int x, int y)
+{
+    char size, bufoffset, zone, k, rebuild;
+    signed char row, txpos, xoffset, cd, desired, delta, ypos;
+
+    bufoffset = (_ms_buffer)?_MS_DLL_ARRAY_SIZE:0;
+    _tiling_xpos = x >> 3;
+    _tiling_xoffset = x & 7;
+    ypos = y >> 4;
+    _tiling_yoffset = y & 0xf;
+    txpos = _tiling_xpos - 2;
+    xoffset = _tiling_xoffset + 16;
+
+    cd = ypos - _tiling_ypos;
+    if (cd > 1 || cd < -1) {
+        // Jump: rebuild this buffer, and let the other one rebuild its lines next frame
+        _tiling_ypos = ypos;
+        _tiling_x = x;
+        _tiling_y = y;
+        _sparse_tiling_goto();
+        X = (_ms_buffer)?0:1;
+        _tiling_buffer_rebuild[X] = 1;
+        if (!_ms_delayed_vscroll) _ms_delayed_vscroll = 3;
+        return;
+    }
+
+    // Horizontal: shift the visible lines of this buffer, or rebuild them when out of their window
+    X = (_ms_buffer)?1:0;
+    rebuild = _tiling_buffer_rebuild[X];
+    _tiling_buffer_rebuild[X] = 0;
+    zone = _ms_vscroll_coarse_offset;
+    row = _tiling_ypos;
+    for (k = 0; k != _MS_NB_SCROLLING_ZONES + 1; k++, row++) {
+        X = zone + bufoffset;
+        cd = txpos - _tiling_zone_xpos[X];
+        if (!rebuild && cd >= -2 && cd < 2) {
+            desired = xoffset + (cd << 3);
+            delta = desired - _tiling_zone_xoffset[X];
+            if (delta) {
+                _tiling_zone_xoffset[X] = desired;
+                _ms_tmpptr = _ms_dls[X];
+                size = _ms_dlend_save_overlay[X];
+                for (Y = 4; Y < size; Y += 5) {
+                    _ms_tmpptr[Y] -= delta;
+                }
+            }
+        } else {
+            _tiling_zone_xpos[X] = txpos;
+            _tiling_zone_xoffset[X] = xoffset;
+            _ms_tmpptr = _ms_dls[X];
+            size = _sparse_tiling_build_row(row, _tiling_xpos, xoffset);
+            X = zone + bufoffset;
+            _ms_dlend[X] = size;
+            _ms_dlend_save_overlay[X] = size;
+#ifdef DMA_CHECK
+            _ms_dldma[X] = _MS_DMA_START_VALUE - _tiling_row_dma;
+            _ms_dldma_save_overlay[X] = _MS_DMA_START_VALUE - _tiling_row_dma; // This buffer only: the other one may be built at another column
+#endif
+        }
+        zone = (zone + 1) & 15;
+    }
+
+    // Vertical: prepare the entering line in the scroll buffer
+    cd = ypos - _tiling_ypos;
+    if (cd) {
+        if (cd > 0) {
+            row = ypos + _MS_NB_SCROLLING_ZONES;
+            zone = (_ms_vscroll_coarse_offset + _MS_NB_SCROLLING_ZONES + 1) & 15;
+        } else {
+            row = ypos;
+            zone = (_ms_vscroll_coarse_offset - 1) & 15;
+        }
+        _ms_tmpptr = _ms_sbuffer;
+        size = _sparse_tiling_build_row(row, _tiling_xpos, xoffset);
+        _ms_sbuffer_size = (size)?size:128; // 128 marks a filled empty buffer
+        _ms_sbuffer_dma = _MS_DMA_START_VALUE - _tiling_row_dma;
+        // Both buffers get this line, built at the same horizontal position
+        X = zone;
+        _tiling_zone_xpos[X] = txpos;
+        _tiling_zone_xoffset[X] = xoffset;
+        X = zone + _MS_DLL_ARRAY_SIZE;
+        _tiling_zone_xpos[X] = txpos;
+        _tiling_zone_xoffset[X] = xoffset;
+        _tiling_ypos = ypos;
+    }
+    multisprite_vertical_scrolling(_tiling_y - y);
+    _tiling_x = x;
+    _tiling_y = y;
+}
+#else
 #define sparse_tiling_goto(x, y) \
     _ms_tmp = x; \
     _tiling_xpos = (((x) >> 8) << 5) | (_ms_tmp >> 3); \
@@ -681,6 +2268,13 @@ void _sparse_tiling_goto()
         bottom += _MS_DLL_ARRAY_SIZE;
     }
     _tiling_right = _tiling_xpos + 21;
+#ifdef SPARSE_TILING_TEMPLATES
+    tmp = -(_tiling_xpos << 3) - _tiling_xoffset;
+    for (X = _ms_tmp; X < bottom; _ms_tmp2++) {
+        _ms_sparse_template_line(_ms_tmp2, tmp);
+        X++;
+    }
+#else
     for (X = _ms_tmp; X < bottom; _ms_tmp2++) {
         Y = _ms_tmp2;
         tmp = _ms_sparse_tiles_ptr_low[Y];
@@ -720,9 +2314,153 @@ void _sparse_tiling_goto()
         } // 167 cycles per tileset / 113,5 = ~1,5 lines per tileset. 
         _ms_dlend[X++] = y;
     }
+#endif
 
     _ms_vscroll_fine_offset = _tiling_yoffset;
     _ms_vertical_scrolling_adjust_bottom_of_screen();
 }
+
+// Camera driven vertical scrolling. Steps of less than 16 pixels scroll incrementally, the line about to enter
+// being queued in the scroll buffer ahead of time. Bigger jumps rebuild the visible zones of the buffer being
+// built, the displayed one being rebuilt on the next frame at the same position, then moved like the other one.
+ramchip int _tiling_camera_y;
+ramchip char _tiling_vqueue; // 0: nothing queued, 1: bottom line queued (scrolling down), 2: top line queued (scrolling up)
+ramchip char _tiling_vbuffer_rebuild[2]; // The visible zones of this buffer must be rebuilt (after a jump)
+
+#ifdef MULTISPRITE_USE_VIDEO_MEMORY
+#ifndef SPARSE_TILING_VSCROLL_BUDGET
+#define SPARSE_TILING_VSCROLL_BUDGET 10 // Time allowed for vmem uploads per frame, in TIM64T intervals (~1 scanline each)
+#endif
+#ifndef SPARSE_TILING_VSCROLL_STEP_COST
+#define SPARSE_TILING_VSCROLL_STEP_COST 3 // Worst case time of a vmem upload step, in TIM64T intervals
+#endif
+#define _sparse_tiling_vscroll_fill(row) multisprite_vscroll_buffer_sparse_tiles_vmem(row)
+#else
+#define _sparse_tiling_vscroll_fill(row) multisprite_vscroll_buffer_sparse_tiles(row)
+#endif
+
+// To be called with the screen off, after multisprite_start (then multisprite_save)
+#define sparse_tiling_vscroll_init(y) \
+    _tiling_camera_y = (y); \
+    _tiling_vqueue = 0; \
+    _tiling_vbuffer_rebuild[0] = 0; \
+    _tiling_vbuffer_rebuild[1] = 0; \
+    sparse_tiling_goto(0, y)
+
+// Rebuilds the visible zones of the buffer being built, at the current coarse offset
+void _sparse_tiling_vscroll_rebuild()
+{
+    char zone, k, size, bufoffset;
+    signed char row;
+    bufoffset = (_ms_buffer)?_MS_DLL_ARRAY_SIZE:0;
+    zone = _ms_vscroll_coarse_offset;
+    row = _tiling_ypos;
+    for (k = 0; k != _MS_NB_SCROLLING_ZONES + 1; k++, row++) {
+        _ms_sbuffer_size = 0;
+        _ms_sbuffer_dma = _MS_DMA_START_VALUE;
+        if (row >= 0 && row < TILING_HEIGHT) {
+            _sparse_tiling_vscroll_fill(row);
+#ifdef MULTISPRITE_USE_VIDEO_MEMORY
+            while (multisprite_vscroll_buffer_sparse_tiles_vmem_step());
+#endif
+        }
+        size = _ms_sbuffer_size & 0x7f;
+        _ms_tmpptr = _ms_dls[X = zone + bufoffset];
+        for (Y = size - 1; Y >= 0; Y--) {
+            _ms_tmpptr[Y] = _ms_sbuffer[Y];
+        }
+        _ms_dlend[X] = size;
+#ifdef MULTISPRITE_OVERLAY
+        _ms_dlend_save_overlay[X] = size;
+#ifdef DMA_CHECK
+        _ms_dldma_save_overlay[X] = _ms_sbuffer_dma;
+#endif
+#endif
+#ifdef DMA_CHECK
+        _ms_dldma[X] = _ms_sbuffer_dma;
+#endif
+        X = zone;
+        _ms_dlend_save[X] = size;
+#ifdef DMA_CHECK
+        _ms_dldma_save[X] = _ms_sbuffer_dma;
+#endif
+        zone = (zone + 1) & 15;
+    }
+    _ms_sbuffer_size = 0;
+    _ms_sbuffer_dma = _MS_DMA_START_VALUE;
+}
+
+// Moves the camera to y, in pixels. To be called once per frame, before displaying the sprites
+void sparse_tiling_vscroll(int y)
+{
+    signed char d, ypos, cd, row;
+    char queue;
+
+    _ms_tmp = y;
+    ypos = (((y) >> 8) << 4) | (_ms_tmp >> 4);
+    cd = ypos - _tiling_ypos;
+    d = y - _tiling_camera_y;
+    if (cd > 1 || cd < -1 || d >= 16 || d <= -16) {
+        // Jump: the displayed buffer must not be touched mid-frame. It is rebuilt on the next frame
+        X = (_ms_buffer)?0:1;
+        _tiling_vbuffer_rebuild[X] = 1;
+        // Rebuild the visible zones of the buffer being built
+        X = (_ms_buffer)?1:0;
+        _tiling_vbuffer_rebuild[X] = 0;
+        _tiling_ypos = ypos;
+        _tiling_yoffset = y & 0xf;
+        _ms_vscroll_fine_offset = _tiling_yoffset;
+        _sparse_tiling_vscroll_rebuild();
+        _ms_vertical_scrolling_adjust_bottom_of_screen();
+        _ms_delayed_vscroll = 3; // The other buffer gets its bottom of screen adjusted at flip
+        _tiling_vqueue = 0;
+        _tiling_camera_y = y;
+        return;
+    }
+    X = (_ms_buffer)?1:0;
+    if (_tiling_vbuffer_rebuild[X]) {
+        // Deferred rebuild after a jump: this buffer is rebuilt at the position of the jump, like the other one,
+        // and the move since then is done below as an incremental step (so a coarse move reaches both buffers)
+        _tiling_vbuffer_rebuild[X] = 0;
+        _sparse_tiling_vscroll_rebuild();
+        _tiling_vqueue = 0;
+    }
+
+    // Queue the line that will enter next in the scroll direction
+    if (d > 0) queue = 1;
+    else if (d < 0) queue = 2;
+    else queue = _tiling_vqueue;
+    if (queue && (queue != _tiling_vqueue || multisprite_vscroll_buffer_empty())) {
+        if (queue == 1) row = _tiling_ypos + _MS_NB_SCROLLING_ZONES + 1;
+        else row = _tiling_ypos - 1;
+        _ms_sbuffer_size = 0;
+        _ms_sbuffer_dma = _MS_DMA_START_VALUE;
+        if (row >= 0 && row < TILING_HEIGHT) _sparse_tiling_vscroll_fill(row);
+        if (!_ms_sbuffer_size) _ms_sbuffer_size = 128; // To mark sbuffer_size != 0
+        _tiling_vqueue = queue;
+    }
+
+#ifdef MULTISPRITE_USE_VIDEO_MEMORY
+    // Upload the chars of the queued line within the time budget. They must be complete when the line enters
+    signed char fine = _ms_vscroll_fine_offset + d;
+    if (fine < 0 || fine >= 16) {
+        while (multisprite_vscroll_buffer_sparse_tiles_vmem_step());
+    } else {
+        *TIM64T = SPARSE_TILING_VSCROLL_BUDGET;
+        while (!(*TIMINT & 0x80) && *INTIM >= SPARSE_TILING_VSCROLL_STEP_COST) {
+            if (!multisprite_vscroll_buffer_sparse_tiles_vmem_step()) break;
+        }
+    }
+#endif
+
+    if (d) {
+        multisprite_vertical_scrolling(-d);
+        if (_ms_delayed_vscroll == 1) _tiling_ypos--;
+        else if (_ms_delayed_vscroll == 2) _tiling_ypos++;
+        _tiling_yoffset = _ms_vscroll_fine_offset;
+    }
+    _tiling_camera_y = y;
+}
+#endif // SPARSE_TILING_8WAY
 #endif // HORIZONTAL_SCROLLING
 #endif // __ATARI7800_SPARSE_TILING__
@@ -0,0 +1,116 @@
+// 8-way sparse tiling checks: line windows far right in the map, and line rebuilds (and their DMA budgets) after a jump.
+// Background is green if all the checks pass, red (0x45) otherwise
+#define DEBUG
+#define DMA_CHECK
+#define SPARSE_TILING_8WAY
+#define TILING_HEIGHT 20
+#include "sparse_tiling.h"
+
+unsigned char X, Y;
+
+// Line r: a 2 tiles tileset at column r, and a 12 tiles tileset at column 200
+#define LINE_SIZE 16
+ramchip char lines[LINE_SIZE * TILING_HEIGHT];
+ramchip char lines_high[TILING_HEIGHT], lines_low[TILING_HEIGHT];
+const char *lines_ptrs[2] = { lines_high, lines_low };
+
+// Returns 1 if the zones [first, first + n[ hold the same DL entries in both buffers
+char same_zones(char first, char n)
+{
+    char *p0, *p1, z, size;
+    for (z = first; n != 0; n--, z = (z + 1) & 15) {
+        size = _ms_dlend[X = z];
+        if (_ms_dlend[X = z + _MS_DLL_ARRAY_SIZE] != size) return 0;
+        p0 = _ms_dls[X = z];
+        p1 = _ms_dls[X = z + _MS_DLL_ARRAY_SIZE];
+        for (Y = 0; Y != size; Y++) {
+            if (p0[Y] != p1[Y]) return 0;
+        }
+    }
+    return 1;
+}
+
+void main()
+{
+    char *ptr, *dl, r, size;
+
+    multisprite_init();
+    *BACKGRND = 0xc8;
+
+    for (ptr = lines, r = 0; r != TILING_HEIGHT; r++, ptr += LINE_SIZE) {
+        ptr[Y = 0] = r + 1; // End
+        ptr[++Y] = r; // Start
+        ptr[++Y] = r; // Low address
+        ptr[++Y] = 0x60; // Mode byte
+        ptr[++Y] = 0xc0; // High address
+        ptr[++Y] = 0x1e; // Palette & width
+        ptr[++Y] = 8; // DMA
+        ptr[++Y] = 211;
+        ptr[++Y] = 200;
+        ptr[++Y] = 0x80 + r;
+        ptr[++Y] = 0x60;
+        ptr[++Y] = 0xc0;
+        ptr[++Y] = 0x14;
+        ptr[++Y] = 20;
+        ptr[++Y] = 96; // End of line
+        ptr[++Y] = 0xff;
+        lines_high[X = r] = ptr >> 8;
+        lines_low[X] = ptr;
+    }
+    sparse_tiling_init(lines_ptrs);
+
+    // Window tests past column 128
+    dl = _ms_dls[X = 0];
+    _ms_tmpptr = dl;
+    size = _sparse_tiling_build_row(0, 200, 16);
+    assert(size == 5);
+    assert(dl[Y = 0] == 0x80);
+    assert(dl[Y = 4] == 0);
+    assert(_tiling_row_dma == 20);
+    _ms_tmpptr = dl;
+    size = _sparse_tiling_build_row(3, 0, 16);
+    assert(size == 5);
+    assert(dl[Y = 0] == 3);
+    assert(dl[Y = 4] == (5 << 3) - 16);
+    _ms_tmpptr = dl;
+    size = _sparse_tiling_build_row(3, 6, 16); // Tileset cut on the left of the window
+    assert(size == 5);
+    assert(dl[Y = 0] == 4);
+    assert(dl[Y = 3] == 0x1f);
+    assert(dl[Y = 4] == 240); // -16
+    _ms_tmpptr = dl;
+    size = _sparse_tiling_build_row(3, 240, 16); // Nothing left on the right of the map
+    assert(size == 0);
+
+    sparse_tiling_goto(0, 0);
+    multisprite_save();
+    multisprite_flip();
+
+    // Horizontal jump to column 200: all the lines are rebuilt
+    sparse_tiling_8way_scroll(1600, 0);
+    X = (_ms_buffer)?_MS_DLL_ARRAY_SIZE:0;
+    assert(_ms_dlend[X] == 5);
+    dl = _ms_dls[X];
+    assert(dl[Y = 0] == 0x80);
+    assert(dl[Y = 4] == 0);
+    multisprite_flip();
+
+    // Vertical jump: this buffer is rebuilt, then the other one on the next frame, at the same position
+    sparse_tiling_8way_scroll(1600, 64);
+    assert(_ms_vscroll_fine_offset == 0);
+    X = (_ms_buffer)?_MS_DLL_ARRAY_SIZE:0;
+    assert(_ms_dldma[X] == _MS_DMA_START_VALUE - 20); // The cost of the previous line is gone
+    multisprite_flip();
+    sparse_tiling_8way_scroll(1600, 64);
+    multisprite_flip();
+    assert(same_zones(_ms_vscroll_coarse_offset, _MS_NB_SCROLLING_ZONES + 1));
+    dl = _ms_dls[X = _ms_vscroll_coarse_offset];
+    assert(dl[Y = 0] == 0x84);
+    assert(_ms_dldma[X = _ms_vscroll_coarse_offset] == _MS_DMA_START_VALUE - 20);
+    assert(_ms_dldma_save_overlay[X = _ms_vscroll_coarse_offset + _MS_DLL_ARRAY_SIZE] == _MS_DMA_START_VALUE - 20);
+
+    while (1) {
+        sparse_tiling_8way_scroll(1600, 64);
+        multisprite_flip();
+    }
+}
@@ -0,0 +1,85 @@
+// Sprite collision checks: pixel accurate mask collisions, and the zone bucketed broadphase.
+// Background is green if all the checks pass, red (0x45) otherwise
+#define DEBUG
+#define MULTISPRITE_BROADPHASE
+#include "multisprite.h"
+
+unsigned char X, Y;
+
+// Sprite masks (2 bytes per row): a 4x4 block and a 1 pixel wide column
+const char block[8] = { 0xf0, 0x00, 0xf0, 0x00, 0xf0, 0x00, 0xf0, 0x00 };
+const char column[8] = { 0x80, 0x00, 0x80, 0x00, 0x80, 0x00, 0x80, 0x00 };
+// A 12 pixels wide sprite (2 mask bytes used), solid on its rightmost 4 pixels, on its 2 bottom rows
+const char corner[8] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0xf0, 0x00, 0xf0 };
+
+void main()
+{
+    char r;
+
+    multisprite_init();
+    *BACKGRND = 0xc8;
+
+    // The box test hits, but only the block against the block hits pixel wise
+    multisprite_compute_mask_collision(10, 20, 4, 4, block, 13, 22, 4, 4, block);
+    assert(_ms_tmp3 == 1);
+    multisprite_compute_mask_collision(10, 20, 4, 4, column, 11, 20, 4, 4, block);
+    assert(_ms_tmp3 == 0);
+    multisprite_compute_mask_collision(11, 20, 4, 4, column, 10, 20, 4, 4, block);
+    assert(_ms_tmp3 == 1);
+    multisprite_compute_mask_collision(10, 20, 4, 4, block, 14, 20, 4, 4, block);
+    assert(_ms_tmp3 == 0);
+
+    // Second mask byte, and rows aligned on the lowest sprite
+    r = _ms_mask_collision(corner, 20, 4, block, 22, 4, 8);
+    assert(r == 1);
+    r = _ms_mask_collision(corner, 20, 4, block, 20, 2, 8);
+    assert(r == 0);
+    r = _ms_mask_collision(corner, 20, 4, block, 22, 4, 12);
+    assert(r == 0);
+
+    // Broadphase: same zone, adjacent zones, and zones 15 and 0 (the object at y = 248 starts above the screen)
+    multisprite_broadphase_clear();
+    multisprite_broadphase_add_a(1, 10, 20, 8, 8);
+    multisprite_broadphase_add_b(2, 14, 24, 8, 8);
+    r = multisprite_broadphase_collide();
+    assert(r == 1);
+    assert(multisprite_hit_a[X = 0] == 1);
+    assert(multisprite_hit_b[X] == 2);
+    multisprite_broadphase_clear();
+    multisprite_broadphase_add_a(3, 10, 28, 8, 8);
+    multisprite_broadphase_add_b(4, 12, 34, 8, 8);
+    r = multisprite_broadphase_collide();
+    assert(r == 1);
+    multisprite_broadphase_clear();
+    multisprite_broadphase_add_a(5, 10, 248, 8, 16);
+    multisprite_broadphase_add_b(6, 12, 4, 8, 8);
+    multisprite_broadphase_add_b(7, 12, 100, 8, 8);
+    r = multisprite_broadphase_collide();
+    assert(r == 1);
+    assert(multisprite_hit_b[X = 0] == 6);
+
+    // Tall objects hit objects 2 zones and more below their top, in both groups
+    multisprite_broadphase_clear();
+    multisprite_broadphase_add_a(8, 10, 20, 8, 48);
+    multisprite_broadphase_add_b(9, 12, 60, 8, 8);
+    multisprite_broadphase_add_b(10, 12, 100, 8, 8);
+    multisprite_broadphase_add_a(11, 40, 100, 8, 8);
+    multisprite_broadphase_add_b(12, 44, 20, 8, 100);
+    r = multisprite_broadphase_collide();
+    assert(r == 2);
+    assert(multisprite_hit_a[X = 0] == 11);
+    assert(multisprite_hit_b[X] == 12);
+    assert(multisprite_hit_a[X = 1] == 8);
+    assert(multisprite_hit_b[X] == 9);
+
+    // Bottom of the screen: the box of the first object is cut at y = 240 instead of wrapping
+    multisprite_broadphase_clear();
+    multisprite_broadphase_add_a(13, 10, 232, 8, 16);
+    multisprite_broadphase_add_b(14, 12, 234, 8, 4);
+    r = multisprite_broadphase_collide();
+    assert(r == 1);
+
+    while (1) {
+        multisprite_flip();
+    }
+}
@@ -0,0 +1,92 @@
+// Sparse tiling video memory cache checks: the lines of both buffers hold references on the vmem slots they show.
+// Background is green if all the checks pass, red (0x45) otherwise
+#define DEBUG
+#define HORIZONTAL_SCROLLING
+#define MULTISPRITE_USE_VIDEO_MEMORY
+#include "sparse_tiling.h"
+
+unsigned char X, Y;
+
+holeydma scattered(16,2) char tiles[64] = {
+    0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55,
+    0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55,
+    0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa,
+    0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa
+};
+const char tileset[2] = { 0, 2 };
+
+// Line 0 shows the tileset once, line 1 twice. The other lines are empty
+ramchip char line0[9], line1[16];
+const char empty_line[2] = { 96, 0xff };
+ramchip char lines_high[SPARSE_TILING_SCROLLING_ZONE], lines_low[SPARSE_TILING_SCROLLING_ZONE];
+const char *lines_ptrs[2] = { lines_high, lines_low };
+
+// Writes a 2 tiles tileset record at ptr, for columns [x, x + 1]
+void record(char *ptr, char x)
+{
+    ptr[Y = 0] = x + 1; // End
+    ptr[++Y] = x; // Start
+    ptr[++Y] = tileset; // Low address
+    ptr[++Y] = 0x60; // Mode byte
+    ptr[++Y] = tileset >> 8; // High address
+    ptr[++Y] = 0x1c; // Palette & width
+    ptr[++Y] = 8; // DMA
+    ptr[++Y] = 96; // End of line
+    ptr[++Y] = 0xff;
+}
+
+void main()
+{
+    char e;
+
+    multisprite_init();
+    *BACKGRND = 0xc8;
+
+    record(line0, 2);
+    record(line1, 2);
+    record(line1 + 7, 6);
+    for (X = SPARSE_TILING_SCROLLING_ZONE - 1; X >= 0; X--) {
+        lines_high[X] = empty_line >> 8;
+        lines_low[X] = empty_line;
+    }
+    lines_high[X = 0] = line0 >> 8;
+    lines_low[X] = line0;
+    lines_high[X = 1] = line1 >> 8;
+    lines_low[X] = line1;
+    sparse_tiling_init_vmem(lines_ptrs, tiles);
+    sparse_tiling_display();
+    multisprite_save();
+
+    // One slot, referenced 3 times in each buffer
+    e = _st_line_entries[X = _st_line_entries_idx[Y = 0]];
+    assert(_st_line_nb_entries[X = 0] == 1);
+    assert(_st_line_nb_entries[X = 1] == 2);
+    assert(_st_line_nb_entries[X = SPARSE_TILING_SCROLLING_ZONE] == 1);
+    assert(_st_line_nb_entries[X = SPARSE_TILING_SCROLLING_ZONE + 1] == 2);
+    assert(_st_line_entries[X = _st_line_entries_idx[Y = SPARSE_TILING_SCROLLING_ZONE]] == e);
+    assert(_st_cache_refcount[X = e] == 6);
+
+    // Reloading a line keeps its references
+    _sparse_tiling_load_line(0);
+    assert(_st_cache_refcount[X = e] == 6);
+
+    // Lines of this buffer scrolled away: the other buffer still shows the slot
+    _tiling_xpos[X = 0] = 100;
+    _sparse_tiling_load_line(0);
+    _tiling_xpos[X = 1] = 100;
+    _sparse_tiling_load_line(1);
+    assert(_st_line_nb_entries[X = 0] == 0);
+    assert(_st_cache_refcount[X = e] == 3);
+
+    // Displaying again releases the previous references of the other buffer
+    _tiling_xpos[X = 0] = 0;
+    _tiling_xpos[X = 1] = 0;
+    _sparse_tiling_set_line(0, line0);
+    _sparse_tiling_set_line(1, line1);
+    sparse_tiling_display();
+    assert(_st_cache_refcount[X = e] == 6);
+
+    while (1) {
+        multisprite_flip();
+    }
+}
@@ -0,0 +1,135 @@
+// Tiling collision checks: queries, sweeps and pixel accurate collisions on a small RAM map.
+// Background is green if all the checks pass, red (0x45) otherwise
+#define DEBUG
+#include "tiling.h"
+
+unsigned char X, Y;
+
+#define MAP_WIDTH 24
+#define MAP_HEIGHT 14
+ramchip char map[MAP_WIDTH * MAP_HEIGHT];
+ramchip char flags[256];
+
+// Tiles (listed top row first): 0 empty, 1 full, 2 bottom half, 3 left half
+reversed scattered(16,2) char tiles[128] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55,
+    0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55,
+    0x55, 0, 0x55, 0, 0x55, 0, 0x55, 0, 0x55, 0, 0x55, 0, 0x55, 0, 0x55, 0,
+    0x55, 0, 0x55, 0, 0x55, 0, 0x55, 0, 0x55, 0, 0x55, 0, 0x55, 0, 0x55, 0
+};
+ramchip char masks[16 * 4];
+
+void main()
+{
+    char *ptr, r;
+
+    multisprite_init();
+    *BACKGRND = 0xc8;
+
+    // Map: a wall (code 2) on column 10 with a gap on row 3, a bottom half tile (code 4) at (3, 5) and its mirror (code 5) at (4, 5)
+    for (ptr = map, r = 0; r != MAP_HEIGHT; r++, ptr += MAP_WIDTH) {
+        for (Y = 0; Y != MAP_WIDTH; Y++) ptr[Y] = 0;
+        ptr[Y = 10] = 2;
+    }
+    map[3 * MAP_WIDTH + 10] = 0;
+    map[5 * MAP_WIDTH + 3] = 4;
+    map[5 * MAP_WIDTH + 4] = 5;
+    X = 0;
+    do {
+        flags[X] = 0;
+        X++;
+    } while (X != 0);
+    flags[X = 2] = TILING_FLAG_SOLID;
+    tiling_init(map, MAP_WIDTH, MAP_HEIGHT, 0, 0, 0);
+    tiling_set_tile_flags(flags);
+
+    // Queries
+    r = tiling_point(84, 0);
+    assert(r == 2);
+    r = tiling_point(0, 0);
+    assert(r == 0);
+    r = tiling_point(0, 240); // Below the map
+    assert(r == 0xff);
+    r = tiling_collision(72, 0, 8, 8);
+    assert(r == 0);
+    assert(tiling_collision_max == 0);
+    r = tiling_collision(76, 0, 8, 8);
+    assert(r == 0);
+    assert(tiling_collision_max == 2);
+    r = tiling_collision_flags(76, 0, 8, 8);
+    assert(r == TILING_FLAG_SOLID);
+    r = tiling_collision_flags(0, 0, 8, 8);
+    assert(r == 0);
+    r = tiling_collision_edges(72, 0, 8, 8);
+    assert(r == TILING_EDGE_RIGHT);
+
+    // Sweeps: stopped by the wall, through the gap, or free
+    r = tiling_sweep(60, 0, 8, 8, 40, 0);
+    assert(r == 12);
+    assert(tiling_sweep_tile == 2);
+    r = tiling_sweep(60, 32, 8, 32, 40, 0); // The column entered holds the gap (tile 0) and the wall
+    assert(r == 12);
+    assert(tiling_sweep_tile == 2);
+    r = tiling_sweep(60, 48, 8, 16, 40, 0);
+    assert(r == 40);
+    assert(tiling_sweep_tile == 0xff);
+    r = tiling_sweep(0, 0, 8, 8, 40, 0);
+    assert(r == 40);
+    r = tiling_sweep(88, 0, 8, 8, -20, 0);
+    assert(r == 0);
+    r = tiling_sweep(88, 0, 8, 8, 20, 20);
+    assert(r == 20);
+
+    // Tile masks (character codes: 2 * tile, plus 1 if vertically mirrored)
+    multisprite_build_tile_masks(tiles, 4, masks);
+    r = _ms_tile_mask_box(4, 0, 0, 7, 7);
+    assert(r == 0);
+    r = _ms_tile_mask_box(4, 0, 7, 7, 8);
+    assert(r == 1);
+    r = _ms_tile_mask_box(5, 0, 0, 7, 7); // Mirrored: top half
+    assert(r == 1);
+    r = _ms_tile_mask_box(5, 0, 8, 7, 15);
+    assert(r == 0);
+    r = _ms_tile_mask_box(6, 4, 0, 7, 15);
+    assert(r == 0);
+    r = _ms_tile_mask_box(6, 3, 0, 3, 0);
+    assert(r == 1);
+    r = _ms_tile_mask_box(8, 0, 0, 7, 15); // Past the masks
+    assert(r == 0);
+
+    // Pixel accurate collisions
+    r = tiling_collision_pixel(24, 80, 8, 4);
+    assert(r == 0xff);
+    r = tiling_collision_pixel(24, 90, 8, 4);
+    assert(r == 4);
+    r = tiling_collision_pixel(32, 80, 8, 4);
+    assert(r == 5);
+    r = tiling_collision_pixel(36, 88, 8, 8);
+    assert(r == 0xff);
+    r = tiling_collision_pixel(78, 0, 4, 4);
+    assert(r == 2);
+    r = tiling_collision_pixel(80, 48, 8, 16); // In the gap
+    assert(r == 0xff);
+
+    // Camera above and left of the map: 2 rows and 2 columns outside
+    tiling_goto(-16, -32);
+    r = tiling_point(0, 0);
+    assert(r == 0xff);
+    r = tiling_point(100, 0);
+    assert(r == 0xff);
+    r = tiling_point(16, 32);
+    assert(r == 0);
+    r = tiling_point(96, 32);
+    assert(r == 2);
+    r = tiling_collision_flags(0, 0, 104, 40);
+    assert(r == TILING_FLAG_SOLID);
+    r = tiling_collision_pixel(0, 0, 104, 40);
+    assert(r == 2);
+
+    while (1) {
+        multisprite_flip();
+    }
+}
@@ -0,0 +1,80 @@
+// Sparse tiling vertical scrolling checks: after a jump, both buffers show the same lines, even if the camera
+// crosses a tile row on the next frame. Background is green if all the checks pass, red (0x45) otherwise
+#define DEBUG
+#define TILING_HEIGHT 24
+#include "sparse_tiling.h"
+
+unsigned char X, Y;
+
+// Line r: a single tile at column r
+#define LINE_SIZE 9
+ramchip char lines[LINE_SIZE * TILING_HEIGHT];
+ramchip char lines_high[TILING_HEIGHT], lines_low[TILING_HEIGHT];
+const char *lines_ptrs[2] = { lines_high, lines_low };
+
+// Returns 1 if the zones [first, first + n[ hold the same DL entries in both buffers
+char same_zones(char first, char n)
+{
+    char *p0, *p1, z, size;
+    for (z = first; n != 0; n--, z = (z + 1) & 15) {
+        size = _ms_dlend[X = z];
+        if (_ms_dlend[X = z + _MS_DLL_ARRAY_SIZE] != size) return 0;
+        p0 = _ms_dls[X = z];
+        p1 = _ms_dls[X = z + _MS_DLL_ARRAY_SIZE];
+        for (Y = 0; Y != size; Y++) {
+            if (p0[Y] != p1[Y]) return 0;
+        }
+    }
+    return 1;
+}
+
+void main()
+{
+    char *ptr, *dl, r;
+
+    multisprite_init();
+    *BACKGRND = 0xc8;
+
+    for (ptr = lines, r = 0; r != TILING_HEIGHT; r++, ptr += LINE_SIZE) {
+        ptr[Y = 0] = r; // End
+        ptr[++Y] = r; // Start
+        ptr[++Y] = r; // Low address
+        ptr[++Y] = 0x60; // Mode byte
+        ptr[++Y] = 0xc0; // High address
+        ptr[++Y] = 0x1f; // Palette & width
+        ptr[++Y] = 8; // DMA
+        ptr[++Y] = 96; // End of line
+        ptr[++Y] = 0xff;
+        lines_high[X = r] = ptr >> 8;
+        lines_low[X] = ptr;
+    }
+    sparse_tiling_init(lines_ptrs);
+    sparse_tiling_vscroll_init(0);
+    multisprite_save();
+    multisprite_flip();
+
+    // Jump to row 2, then cross row 3 on the next frame
+    sparse_tiling_vscroll(47);
+    assert(_ms_vscroll_fine_offset == 15);
+    multisprite_flip();
+    sparse_tiling_vscroll(49);
+    assert(_tiling_ypos == 3);
+    assert(_ms_vscroll_coarse_offset == 1);
+    multisprite_flip();
+    // Zones [1, 15[ show the lines [3, 17[ in both buffers (zone 15, entering, comes from the scroll buffer)
+    assert(same_zones(_ms_vscroll_coarse_offset, _MS_NB_SCROLLING_ZONES));
+    dl = _ms_dls[X = _ms_vscroll_coarse_offset];
+    assert(dl[Y = 0] == 3);
+
+    // Incremental steps keep them in sync
+    sparse_tiling_vscroll(51);
+    multisprite_flip();
+    sparse_tiling_vscroll(53);
+    multisprite_flip();
+    assert(same_zones(_ms_vscroll_coarse_offset, _MS_NB_SCROLLING_ZONES));
+
+    while (1) {
+        sparse_tiling_vscroll(53);
+        multisprite_flip();
+    }
+}
@@ -11,59 +11,392 @@
 #define VERTICAL_SCROLLING
 #include "multisprite.h"
 
-ramchip char *_tiling_tilemap_ptr, _tiling_width, _tiling_height;
+// TILING_LARGE_MAPS: 16-bit tile coordinates and map sizes (default is up to ~127 tiles in each direction)
+// TILING_ROW_TABLE: O(1) row lookup through a row pointer table (ROM or RAM) provided by tiling_set_row_table
+// TILING_STREAMING: RLE compressed map, decoded row by row into a RAM ring as the camera moves (see tiling_init_streaming)
+// TILING_METATILES: map of 2x2 (or 4x4 with TILING_METATILES_4X4) metatiles, expanded into the same RAM ring (see tiling_init_metatiles)
+#ifdef TILING_METATILES
+#ifndef TILING_STREAMING
+#define TILING_STREAMING
+#endif
+#endif
+
+#ifdef TILING_LARGE_MAPS
+#define _TILING_SIZE int
+#define _TILING_COORD int
+#else
+#define _TILING_SIZE char
+#define _TILING_COORD signed char
+#endif
+
+ramchip char *_tiling_tilemap_ptr;
+ramchip _TILING_SIZE _tiling_width, _tiling_height;
+ramchip char *_tiling_row_ptr;
+#ifdef TILING_ROW_TABLE
+ramchip char *_tiling_row_table_low, *_tiling_row_table_high;
+
+// To be called before tiling_init. Tables hold the low and high bytes of the address of each row of the map
+#define tiling_set_row_table(table_low, table_high) \
+    _tiling_row_table_low = (table_low); \
+    _tiling_row_table_high = (table_high);
+
+// Generates the row pointer table in RAM (both tables must be at least height bytes long)
+void tiling_build_row_table(char *ptr, _TILING_SIZE width, _TILING_SIZE height, char *table_low, char *table_high)
+{
+    _TILING_SIZE i;
+    for (i = height; i != 0; i--) {
+        table_low[Y = 0] = ptr;
+        table_high[Y] = ptr >> 8;
+        table_low++;
+        table_high++;
+        ptr += width;
+    }
+}
+#endif
+
+// Camera state (kept by tiling_goto and tiling_scroll)
+ramchip int _tiling_x, _tiling_y;
+ramchip _TILING_COORD _tiling_xpos, _tiling_ypos;
+ramchip signed char _tiling_xoffset, _tiling_yoffset;
+ramchip char *_tiling_top_row_ptr, *_tiling_bottom_row_ptr; // Tilemap rows displayed on the top and bottom zones
+ramchip char _tiling_palette;
+// What is actually stored in the display lists of each buffer (low bytes of the tile coordinates)
+ramchip signed char _tiling_buffer_xpos[2], _tiling_buffer_xoffset[2], _tiling_buffer_ypos[2];
+ramchip char _tiling_buffer_rebuild[2];
+
+// Optional tile flags table (256 bytes, one byte of flags per tile index) for tiling_collision_flags and
+// tiling_collision_edges (bit TILING_FLAG_SOLID)
+#define TILING_FLAG_SOLID 1
+#define TILING_EDGE_LEFT 1
+#define TILING_EDGE_RIGHT 2
+#define TILING_EDGE_TOP 4
+#define TILING_EDGE_BOTTOM 8
+ramchip char *_tiling_tile_flags;
+ramchip char _tiling_collision_min, _tiling_collision_max, _tiling_collision_mask;
+ramchip char _tiling_collision_solid; // First TILING_FLAG_SOLID tile met by the last scan (-1 if none)
+
+// To be called after tiling_init
+#define tiling_set_tile_flags(flags) _tiling_tile_flags = (flags);
+
+// Row pointer table lookup into _tiling_row_ptr
+#ifdef TILING_LARGE_MAPS
+#define _tiling_table_lookup(table_low, table_high, row) \
+    _ms_tmpptr = (table_low) + (row); \
+    _ms_tmpptr2 = (table_high) + (row); \
+    _tiling_row_ptr = _ms_tmpptr[Y = 0] | (_ms_tmpptr2[Y] << 8);
+#else
+#define _tiling_table_lookup(table_low, table_high, row) \
+    Y = (row); \
+    _tiling_row_ptr = (table_low)[Y] | ((table_high)[Y] << 8);
+#endif
+
+#ifdef TILING_STREAMING
+// Streaming mode: the map is made of RLE compressed rows, addressed through a row pointer table.
+// RLE format: n < 0x80 : n + 1 literal tiles follow, n >= 0x80 : next tile is repeated (n & 0x7f) + 1 times.
+// Only the rows around the camera are decoded, in a ring of 16 rows of TILING_STREAMING_ROW_SIZE tiles,
+// and the tiles display list entries point into this ring. The ring holds whole rows, so the width of the
+// map is limited to TILING_STREAMING_ROW_SIZE (16 * TILING_STREAMING_ROW_SIZE bytes of RAM): wider maps are
+// clipped by tiling_init, which counts it as an error in _ms_dmaerror.
+#ifndef TILING_STREAMING_ROW_SIZE
+#define TILING_STREAMING_ROW_SIZE 32
+#endif
+#define _TILING_RING_SIZE (16 * TILING_STREAMING_ROW_SIZE)
+ramchip char _tiling_ring[_TILING_RING_SIZE];
+const char *_tiling_ring_rows[16] = {
+    _tiling_ring, _tiling_ring + TILING_STREAMING_ROW_SIZE, _tiling_ring + 2 * TILING_STREAMING_ROW_SIZE, _tiling_ring + 3 * TILING_STREAMING_ROW_SIZE,
+    _tiling_ring + 4 * TILING_STREAMING_ROW_SIZE, _tiling_ring + 5 * TILING_STREAMING_ROW_SIZE, _tiling_ring + 6 * TILING_STREAMING_ROW_SIZE, _tiling_ring + 7 * TILING_STREAMING_ROW_SIZE,
+    _tiling_ring + 8 * TILING_STREAMING_ROW_SIZE, _tiling_ring + 9 * TILING_STREAMING_ROW_SIZE, _tiling_ring + 10 * TILING_STREAMING_ROW_SIZE, _tiling_ring + 11 * TILING_STREAMING_ROW_SIZE,
+    _tiling_ring + 12 * TILING_STREAMING_ROW_SIZE, _tiling_ring + 13 * TILING_STREAMING_ROW_SIZE, _tiling_ring + 14 * TILING_STREAMING_ROW_SIZE, _tiling_ring + 15 * TILING_STREAMING_ROW_SIZE
+};
+ramchip char *_tiling_stream_table_low, *_tiling_stream_table_high;
+
+#define tiling_init_streaming(table_low, table_high, width, height, x, y, palette) \
+    _tiling_stream_table_low = (table_low); \
+    _tiling_stream_table_high = (table_high); \
+    tiling_init(_tiling_ring, width, height, x, y, palette)
+
+#define _tiling_next_row(ptr) \
+    ptr += TILING_STREAMING_ROW_SIZE; \
+    if (ptr >= _tiling_ring + _TILING_RING_SIZE) ptr -= _TILING_RING_SIZE;
+#define _tiling_prev_row(ptr) \
+    ptr -= TILING_STREAMING_ROW_SIZE; \
+    if (ptr < _tiling_ring) ptr += _TILING_RING_SIZE;
+
+// Tiles changed by tiling_set_tile, applied again each time their row is decoded in the ring
+#ifndef TILING_MAX_EDITS
+#define TILING_MAX_EDITS 16
+#endif
+ramchip char _tiling_edit_col[TILING_MAX_EDITS], _tiling_edit_row[TILING_MAX_EDITS], _tiling_edit_tile[TILING_MAX_EDITS];
+#ifdef TILING_LARGE_MAPS
+ramchip char _tiling_edit_row_high[TILING_MAX_EDITS];
+#endif
+ramchip char _tiling_nb_edits;
+
+// Applies the recorded edits of this row to its slot of the ring
+void _tiling_apply_edits(_TILING_COORD row)
+{
+    char *dst;
+    char c = row;
+    dst = _tiling_ring_rows[X = c & 15];
+    for (X = _tiling_nb_edits - 1; X >= 0; X--) {
+#ifdef TILING_LARGE_MAPS
+        if (_tiling_edit_row[X] == c && _tiling_edit_row_high[X] == (row >> 8)) {
+#else
+        if (_tiling_edit_row[X] == c) {
+#endif
+            Y = _tiling_edit_col[X];
+            dst[Y] = _tiling_edit_tile[X];
+        }
+    }
+}
+
+#ifdef TILING_METATILES
+// Metatile definitions are stored as planes of TILING_NB_METATILES bytes, one plane per tile of the metatile,
+// in row major order: for 2x2, top left tiles of all the metatiles, then top right, bottom left and bottom right.
+#ifndef TILING_NB_METATILES
+#define TILING_NB_METATILES 256
+#endif
+#ifdef TILING_METATILES_4X4
+#define _TILING_METATILE_SHIFT 2
+#define _TILING_METATILE_SIZE 4
+#else
+#define _TILING_METATILE_SHIFT 1
+#define _TILING_METATILE_SIZE 2
+#endif
+ramchip char *_tiling_metamap_ptr, *_tiling_metatiles_ptr;
+ramchip _TILING_SIZE _tiling_metamap_width;
+
+// width and height are given in metatiles
+#define tiling_init_metatiles(metamap, metatiles, width, height, x, y, palette) \
+    _tiling_metamap_ptr = (metamap); \
+    _tiling_metatiles_ptr = (metatiles); \
+    _tiling_metamap_width = (width); \
+    tiling_init(_tiling_ring, (width) << _TILING_METATILE_SHIFT, (height) << _TILING_METATILE_SHIFT, x, y, palette)
+
+// Expands one row of tiles of the map into its slot of the ring
+void _tiling_stream_row(_TILING_COORD row)
+{
+    char *src, *dst, *p0, *p1;
+#ifdef TILING_METATILES_4X4
+    char *p2, *p3;
+#endif
+    char c, m, t0, t1;
+    _TILING_SIZE i;
+    _TILING_COORD r;
+    int w;
+
+    c = row;
+    dst = _tiling_ring_rows[X = c & 15];
+    // Plane of the metatile definitions for this row of tiles
+    p0 = _tiling_metatiles_ptr;
+    for (m = c & (_TILING_METATILE_SIZE - 1); m != 0; m--) {
+        p0 += _TILING_METATILE_SIZE * TILING_NB_METATILES;
+    }
+    p1 = p0 + TILING_NB_METATILES;
+#ifdef TILING_METATILES_4X4
+    p2 = p1 + TILING_NB_METATILES;
+    p3 = p2 + TILING_NB_METATILES;
+#endif
+    // Row of the metatiles map (shift and add multiplication)
+    src = _tiling_metamap_ptr;
+    w = _tiling_metamap_width;
+    for (r = row >> _TILING_METATILE_SHIFT; r > 0; r >>= 1) {
+        if (r & 1) src += w;
+        w <<= 1;
+    }
+    for (i = _tiling_width >> _TILING_METATILE_SHIFT; i != 0; i--) { // Clipped to the ring row
+        m = src[Y = 0];
+        src++;
+        Y = m;
+        t0 = p0[Y];
+        t1 = p1[Y];
+#ifdef TILING_METATILES_4X4
+        c = p2[Y];
+        m = p3[Y];
+        Y = 0;
+        dst[Y++] = t0;
+        dst[Y++] = t1;
+        dst[Y++] = c;
+        dst[Y] = m;
+#else
+        Y = 0;
+        dst[Y++] = t0;
+        dst[Y] = t1;
+#endif
+        dst += _TILING_METATILE_SIZE;
+    }
+    _tiling_apply_edits(row);
+}
+#else
+// Decodes one row of the map into its slot of the ring
+void _tiling_stream_row(_TILING_COORD row)
+{
+    char *src, *dst, *end;
+    char n, c;
+    _tiling_table_lookup(_tiling_stream_table_low, _tiling_stream_table_high, row);
+    src = _tiling_row_ptr;
+    c = row;
+    dst = _tiling_ring_rows[X = c & 15];
+    end = dst + _tiling_width;
+    while (dst < end) {
+        n = src[Y = 0];
+        if (n & 0x80) { // Repeat run
+            c = src[Y = 1];
+            n &= 0x7f;
+            if (dst + n >= end) n = end - dst - 1; // Clipped to the ring row
+            for (Y = n; Y >= 0; Y--) dst[Y] = c;
+            src += 2;
+        } else { // Literal run
+            src++;
+            if (dst + n >= end) n = end - dst - 1;
+            for (Y = n; Y >= 0; Y--) dst[Y] = src[Y];
+            src += n + 1;
+        }
+        dst += n + 1;
+    }
+    _tiling_apply_edits(row);
+}
+#endif
 
-void tiling_init(char *ptr, char width, char height, int x, int y, char palette)
+// Decodes all the rows displayed from the given top row (i.e. after a teleport)
+void _tiling_stream_rows(_TILING_COORD top)
+{
+    _TILING_COORD row;
+    char j;
+    for (row = top, j = _MS_NB_SCROLLING_ZONES + 1; j != 0; row++, j--) {
+        if (row >= _tiling_height) break;
+        if (row >= 0) _tiling_stream_row(row);
+    }
+}
+#else
+#define _tiling_next_row(ptr) ptr += _tiling_width;
+#define _tiling_prev_row(ptr) ptr -= _tiling_width;
+#endif
+
+// Sets _tiling_row_ptr to the first tile of the given row (row >= 0)
+void _tiling_get_row(_TILING_COORD row)
+{
+#ifdef TILING_STREAMING
+    _ms_tmp = row;
+    _tiling_row_ptr = _tiling_ring_rows[X = _ms_tmp & 15];
+#else
+#ifdef TILING_ROW_TABLE
+    _tiling_table_lookup(_tiling_row_table_low, _tiling_row_table_high, row);
+#else
+    // Shift and add multiplication: O(log(row)) instead of O(row)
+    int w;
+    _TILING_COORD r;
+    _tiling_row_ptr = _tiling_tilemap_ptr;
+    w = _tiling_width;
+    for (r = row; r > 0; r >>= 1) {
+        if (r & 1) _tiling_row_ptr += w;
+        w <<= 1;
+    }
+#endif
+#endif
+}
+
+// Next zone of the current buffer, taking into account vertical scrolling wrap around
+#define _tiling_next_zone() \
+    X++; \
+    if (X == _MS_DLL_ARRAY_SIZE) X = 0; \
+    else if (X == _MS_DLL_ARRAY_SIZE * 2) X = _MS_DLL_ARRAY_SIZE;
+
+// Pixel coordinates to tile coordinates (8x16 tiles). Expects xpos, ypos, xoffset, yoffset and j locals
+#ifdef TILING_LARGE_MAPS
+#define _tiling_pixels_to_tiles(x, y) \
+    xpos = (x) >> 3; \
+    xoffset = (x) & 7; \
+    ypos = (y) >> 4; \
+    yoffset = (y) & 0xf;
+#else
+#define _tiling_pixels_to_tiles(x, y) \
+    j = (x); \
+    xpos = (((x) >> 8) << 5) | (j >> 3); \
+    xoffset = (x) & 7; \
+    j = (y); \
+    ypos = ((((y) >> 8)) << 4) | (j >> 4); \
+    yoffset = (y) & 0xf;
+#endif
+
+void tiling_init(char *ptr, _TILING_SIZE width, _TILING_SIZE height, int x, int y, char palette)
 {
     char *_tiling_ptr, *tmpptr2;
     signed char i;
     char j, k;
-    signed char xpos, ypos, xoffset, yoffset;
+    _TILING_COORD xpos, ypos;
+    signed char xoffset, yoffset;
     _tiling_tilemap_ptr = (ptr);
     _tiling_width = (width);
     _tiling_height = (height);
-    j = x;
-    xpos = (((x) >> 8) << 5) | (j >> 3);
-    xoffset = (x) & 7;
-    j = y;
-    ypos = ((((y) >> 8)) << 4) | (j >> 4);
-    yoffset = (y) & 0xf;
+    _tiling_pixels_to_tiles(x, y);
     k = palette;
-    _tiling_ptr = _tiling_tilemap_ptr;
-    for (i = 0; i < ypos; i++) {
-       _tiling_ptr += _tiling_width;
+    _tiling_tile_flags = 0;
+#ifdef TILING_STREAMING
+    if (_tiling_width > TILING_STREAMING_ROW_SIZE) { // Doesn't fit in the ring
+        _ms_dmaerror++;
+        _tiling_width = TILING_STREAMING_ROW_SIZE;
     }
+    _tiling_nb_edits = 0;
+    _tiling_stream_rows(ypos);
+#endif
+    if (ypos > 0) {
+        _tiling_get_row(ypos);
+        _tiling_ptr = _tiling_row_ptr;
+    } else {
+        _tiling_ptr = _tiling_tilemap_ptr;
+    }
+    _tiling_top_row_ptr = _tiling_ptr;
     _tiling_ptr += xpos;
     i = -xoffset;
     for (tmpptr2 = _tiling_ptr, j = 0; j != _MS_NB_SCROLLING_ZONES + 1; j++) {
         multisprite_display_tiles_fast(i, j, tmpptr2, 21, k);
-        tmpptr2 += _tiling_width;
+        _tiling_next_row(tmpptr2);
     }
+    _tiling_get_row(ypos + _MS_NB_SCROLLING_ZONES);
+    _tiling_bottom_row_ptr = _tiling_row_ptr;
     _ms_vscroll_fine_offset = yoffset;
     _ms_vertical_scrolling_adjust_bottom_of_screen();
+
+    _tiling_x = x;
+    _tiling_y = y;
+    _tiling_xpos = xpos;
+    _tiling_ypos = ypos;
+    _tiling_xoffset = xoffset;
+    _tiling_yoffset = yoffset;
+    _tiling_palette = palette;
+    // multisprite_save() will copy this to both buffers
+    for (X = 1; X >= 0; X--) {
+        _tiling_buffer_xpos[X] = xpos;
+        _tiling_buffer_ypos[X] = ypos;
+        _tiling_buffer_xoffset[X] = xoffset;
+        _tiling_buffer_rebuild[X] = 0;
+    }
 }
 
-void tiling_goto(int x, int y)
+void _tiling_goto(int x, int y)
 {
     char *_tiling_ptr, *tmpptr, *tmpptr2;
     signed char i;
     char j, k;
     char palette_and_width;
-    char bottom;
-    signed char xpos, ypos, xoffset, yoffset;
-
-    j = x;
-    xpos = (((x) >> 8) << 5) | (j >> 3);
-    xoffset = (x) & 7;
-    j = y;
-    ypos = ((((y) >> 8)) << 4) | (j >> 4);
-    yoffset = (y) & 0xf;
-    _tiling_ptr = _tiling_tilemap_ptr;
+    char bottom, rebuild;
+    _TILING_COORD xpos, ypos;
+    signed char xoffset, yoffset;
 
-    for (i = 0; i < ypos; i++) {
-       _tiling_ptr += _tiling_width;
+    _tiling_pixels_to_tiles(x, y);
+#ifdef TILING_STREAMING
+    _tiling_stream_rows(ypos);
+#endif
+    if (ypos > 0) {
+        _tiling_get_row(ypos);
+        _tiling_ptr = _tiling_row_ptr;
+    } else {
+        _tiling_ptr = _tiling_tilemap_ptr;
     }
-    X = 0; 
+    _tiling_top_row_ptr = _tiling_ptr;
+    rebuild = 0;
+    X = _ms_vscroll_coarse_offset;
     if (_ms_buffer) X += _MS_DLL_ARRAY_SIZE; 
     tmpptr = _ms_dls[X]; 
     palette_and_width = tmpptr[Y = 3]; // Get the palette and width
@@ -71,16 +404,19 @@ void tiling_goto(int x, int y)
         // Fill with blank
         k = -ypos;
         for (j = 0; j < k; j++) {
-            tmpptr = _ms_dls[X++]; 
+            tmpptr = _ms_dls[X];
             Y = 3; 
             tmpptr[Y++] = palette_and_width | 0x1f; 
             tmpptr[Y] = 160; // Out of screen 
+            _tiling_next_zone();
         }
+        rebuild = 1;
     } else {
         j = 0;
     }
     if (xpos + 21 >= _tiling_width) {
         palette_and_width = palette_and_width & 0xe0 | ((xpos - _tiling_width) & 0x1f);
+        if (xpos >= _tiling_width) rebuild = 1;
     } else {
         palette_and_width = palette_and_width & 0xe0 | (-21 & 0x1f);
     }
@@ -89,33 +425,405 @@ void tiling_goto(int x, int y)
         _tiling_ptr += xpos;
     } else {
         i -= (xpos << 3);
+        if (xpos) rebuild = 1;
     }
     if (ypos + (_MS_NB_SCROLLING_ZONES + 1) >= _tiling_height) {
         bottom = _tiling_height - ypos;
+        if (ypos >= _tiling_height) rebuild = 1;
     } else {
         bottom = _MS_NB_SCROLLING_ZONES + 1;
     }
     for (tmpptr2 = _tiling_ptr; j < bottom; j++) {
-        tmpptr = _ms_dls[X++]; 
+        tmpptr = _ms_dls[X];
         Y = 0; 
         tmpptr[Y++] = tmpptr2; 
         Y++;
         tmpptr[Y++] = tmpptr2 >> 8; 
         tmpptr[Y++] = palette_and_width; 
         tmpptr[Y] = i; 
-        tmpptr2 += _tiling_width;
+        _tiling_next_row(tmpptr2);
+        _tiling_next_zone();
     }
     for (; j < _MS_NB_SCROLLING_ZONES + 1; j++) {
-        tmpptr = _ms_dls[X++]; 
+        tmpptr = _ms_dls[X];
         Y = 3; 
         tmpptr[Y++] = palette_and_width | 0x1f; 
         tmpptr[Y] = 160; // Out of screen 
+        _tiling_next_zone();
+    }
+    if (!rebuild) {
+        // Bottom row may be past the end of the map: stepped from the top one, as tiling_scroll does
+        tmpptr2 = _tiling_top_row_ptr;
+        for (j = _MS_NB_SCROLLING_ZONES; j != 0; j--) {
+            _tiling_next_row(tmpptr2);
+        }
+        _tiling_bottom_row_ptr = tmpptr2;
     }
 
     _ms_vscroll_fine_offset = yoffset;
     _ms_vertical_scrolling_adjust_bottom_of_screen();
+    if (!_ms_delayed_vscroll) _ms_delayed_vscroll = 3; // Adjust the bottom of screen of the other buffer at flip time
+
+    _tiling_x = x;
+    _tiling_y = y;
+    _tiling_xpos = xpos;
+    _tiling_ypos = ypos;
+    _tiling_xoffset = xoffset;
+    _tiling_yoffset = yoffset;
+    X = _ms_buffer;
+    _tiling_buffer_xpos[X] = xpos;
+    _tiling_buffer_ypos[X] = ypos;
+    _tiling_buffer_xoffset[X] = xoffset;
+    _tiling_buffer_rebuild[X] = rebuild; // Left and top borders of the map are only handled by tiling_goto
+}
+
+void tiling_goto(int x, int y)
+{
+    _tiling_goto(x, y);
+    // The other buffer is out of date, and will be rebuilt on next tiling_scroll
+    if (_ms_buffer) X = 0; else X = 1;
+    _tiling_buffer_rebuild[X] = 1;
 }
 
+// Incremental camera move. Only the bytes that changed are patched in the display lists:
+// x bytes for a sub-tile move, pointer bytes for a coarse horizontal move, and new rows are
+// fed through the vertical scroll buffer. At the right and bottom borders of the map, rows are
+// clipped and zones past the map are left blank. Falls back to tiling_goto for big moves (dx >= 8
+// or dy >= 16 pixels) and when the camera goes past the left or top border of the map.
+void tiling_scroll(int dx, int dy)
+{
+    char *tmpptr, *tmpptr2;
+    char j, cols, rows, patch_ptr, patch_x;
+    _TILING_COORD xpos, ypos;
+    signed char xoffset, yoffset, vmove;
+
+    if (dx >= 8 || dx <= -8 || dy >= 16 || dy <= -16) {
+        tiling_goto(_tiling_x + dx, _tiling_y + dy);
+        return;
+    }
+    _tiling_x += dx;
+    _tiling_y += dy;
+    _tiling_pixels_to_tiles(_tiling_x, _tiling_y);
+
+    j = _tiling_ypos;
+    X = _ms_buffer;
+    if (_tiling_buffer_rebuild[X] || _tiling_buffer_ypos[X] != j || xpos < 0 || xpos >= _tiling_width || ypos < 0 || ypos >= _tiling_height) {
+        _tiling_goto(_tiling_x, _tiling_y);
+        return;
+    }
+    // Visible part of the map
+    if (xpos + 21 > _tiling_width) cols = _tiling_width - xpos; else cols = 21;
+    if (ypos + (_MS_NB_SCROLLING_ZONES + 1) > _tiling_height) rows = _tiling_height - ypos; else rows = _MS_NB_SCROLLING_ZONES + 1;
+
+    // Vertical move. The entering row is queued in the scroll buffer
+    vmove = ypos - _tiling_ypos;
+    if (vmove) {
+        if (vmove > 0) {
+#ifdef TILING_STREAMING
+            if (rows == _MS_NB_SCROLLING_ZONES + 1) _tiling_stream_row(ypos + _MS_NB_SCROLLING_ZONES);
 #endif
+            _tiling_next_row(_tiling_top_row_ptr);
+            _tiling_next_row(_tiling_bottom_row_ptr);
+            tmpptr = _tiling_bottom_row_ptr + xpos;
+        } else {
+#ifdef TILING_STREAMING
+            _tiling_stream_row(ypos);
+#endif
+            _tiling_prev_row(_tiling_top_row_ptr);
+            _tiling_prev_row(_tiling_bottom_row_ptr);
+            tmpptr = _tiling_top_row_ptr + xpos;
+        }
+        // Past the bottom of the map, nothing is queued and the entering zone is blank
+        if (vmove < 0 || rows == _MS_NB_SCROLLING_ZONES + 1) {
+            multisprite_vscroll_buffer_tiles(-xoffset, tmpptr, cols, _tiling_palette);
+        }
+        X = _ms_buffer;
+        _tiling_buffer_ypos[X] = ypos;
+        // The other buffer gets the same DLL move at flip time, with a new row at this frame's horizontal position
+        if (_ms_buffer) X = 0; else X = 1;
+        _tiling_buffer_ypos[X] += vmove;
+        _tiling_buffer_xpos[X] = -1;
+        _tiling_buffer_xoffset[X] = -1;
+    }
+    if (dy) {
+        multisprite_vertical_scrolling(-dy);
+    }
+
+    // Horizontal move
+    j = xpos;
+    X = _ms_buffer;
+    patch_ptr = (j != _tiling_buffer_xpos[X]);
+    patch_x = (xoffset != _tiling_buffer_xoffset[X]);
+    _tiling_buffer_xpos[X] = xpos;
+    _tiling_buffer_xoffset[X] = xoffset;
+    if (patch_ptr || patch_x) {
+        tmpptr2 = _tiling_top_row_ptr + xpos;
+        X = _ms_vscroll_coarse_offset;
+        if (_ms_buffer) X += _MS_DLL_ARRAY_SIZE;
+        for (j = rows; j != 0; j--) { // Zones past the bottom of the map stay blank
+            tmpptr = _ms_dls[X];
+            if (patch_ptr) {
+                tmpptr[Y = 0] = tmpptr2;
+                tmpptr[Y = 2] = tmpptr2 >> 8;
+                Y = 3;
+                tmpptr[Y] = tmpptr[Y] & 0xe0 | (-cols & 0x1f); // Clipped at the right border
+                _tiling_next_row(tmpptr2);
+            }
+            if (patch_x) {
+                tmpptr[Y = 4] = -xoffset;
+            }
+            _tiling_next_zone();
+        }
+    }
+
+    _tiling_xpos = xpos;
+    _tiling_ypos = ypos;
+    _tiling_xoffset = xoffset;
+    _tiling_yoffset = yoffset;
+}
+
+// Changes the tile at (x, y), in tiles (destructible scenery, pickups...). The display lists point into the map,
+// so the change is on screen at next frame and seen by collision tests, with no DL update. The map must be in RAM.
+// In streaming mode, the change is made in the ring and recorded (up to TILING_MAX_EDITS) to survive the row
+// being decoded again. Returns 0 if it couldn't be recorded
+char tiling_set_tile(_TILING_COORD x, _TILING_COORD y, char tile)
+{
+    char *dst;
+#ifdef TILING_STREAMING
+    char c = y;
+    // Already recorded ?
+    for (X = _tiling_nb_edits - 1; X >= 0; X--) {
+#ifdef TILING_LARGE_MAPS
+        if (_tiling_edit_row[X] == c && _tiling_edit_row_high[X] == (y >> 8) && _tiling_edit_col[X] == x) break;
+#else
+        if (_tiling_edit_row[X] == c && _tiling_edit_col[X] == x) break;
+#endif
+    }
+    if (X < 0) {
+        if (_tiling_nb_edits == TILING_MAX_EDITS) return 0;
+        X = _tiling_nb_edits;
+        _tiling_nb_edits++;
+        _tiling_edit_row[X] = c;
+#ifdef TILING_LARGE_MAPS
+        _tiling_edit_row_high[X] = y >> 8;
+#endif
+        _tiling_edit_col[X] = x;
+    }
+    _tiling_edit_tile[X] = tile;
+    // Only the displayed rows are sure to be in the ring (the 16th slot holds the row above or below the screen,
+    // depending on the last move). The others get the edit when they are decoded, before entering the screen
+    if (y < _tiling_ypos || y > _tiling_ypos + _MS_NB_SCROLLING_ZONES) return 1;
+#endif
+    _tiling_get_row(y);
+    dst = _tiling_row_ptr + x;
+    dst[Y = 0] = tile;
+    return 1;
+}
+
+// Returns the tile at (x, y), in tiles. In streaming mode, only valid for the displayed rows
+char tiling_get_tile(_TILING_COORD x, _TILING_COORD y)
+{
+    char *ptr;
+    _tiling_get_row(y);
+    ptr = _tiling_row_ptr + x;
+    return ptr[Y = 0];
+}
+
+
+// Collision queries. Coordinates are screen pixels (like the sprites), converted with the current camera
+// (tiling_goto / tiling_scroll). Tiles outside of the map are ignored. With TILING_STREAMING, only the displayed
+// rows are sure to be decoded in the ring: the rows above and below the screen are treated as outside of the map
+// (a sweep going off screen doesn't see the walls there)
+
+// Results of the last query
+#define tiling_collision_min (_tiling_collision_min)
+#define tiling_collision_max (_tiling_collision_max)
+#define tiling_collision_mask (_tiling_collision_mask)
 
+// Screen pixel to tile coordinates
+#define _tiling_screen_col(x) (_tiling_xpos + (((x) + _tiling_xoffset) >> 3))
+#define _tiling_screen_row(y) (_tiling_ypos + (((y) + _tiling_yoffset) >> 4))
 
+// Scans the tiles from (c0, r0) to (c1, r1) included: min and max tile indexes, OR of their flags, and first solid tile
+void _tiling_scan(_TILING_COORD c0, _TILING_COORD r0, _TILING_COORD c1, _TILING_COORD r1)
+{
+    char *ptr, *flags, n, t, m;
+    _tiling_collision_min = -1;
+    _tiling_collision_max = 0;
+    _tiling_collision_mask = 0;
+    _tiling_collision_solid = -1;
+#ifdef TILING_STREAMING
+    if (r0 < _tiling_ypos) r0 = _tiling_ypos;
+    if (r1 > _tiling_ypos + _MS_NB_SCROLLING_ZONES) r1 = _tiling_ypos + _MS_NB_SCROLLING_ZONES;
+#endif
+    if (c0 < 0) c0 = 0;
+    if (r0 < 0) r0 = 0;
+    if (c1 >= _tiling_width) c1 = _tiling_width - 1;
+    if (r1 >= _tiling_height) r1 = _tiling_height - 1;
+    if (c0 > c1 || r0 > r1) return;
+    n = c1 - c0 + 1;
+    flags = _tiling_tile_flags;
+    _tiling_get_row(r0);
+    ptr = _tiling_row_ptr + c0;
+    for (; r0 <= r1; r0++) {
+        for (Y = 0; Y != n; Y++) {
+            t = ptr[Y];
+            if (t < _tiling_collision_min) _tiling_collision_min = t;
+            if (t >= _tiling_collision_max) _tiling_collision_max = t;
+            if (flags) {
+                _save_y = Y;
+                m = flags[Y = t];
+                _tiling_collision_mask |= m;
+                if (m & TILING_FLAG_SOLID) {
+                    if (_tiling_collision_solid == 0xff) _tiling_collision_solid = t;
+                }
+                Y = _save_y;
+            }
+        }
+        _tiling_next_row(ptr);
+    }
+}
+
+// Returns the minimum tile index under the (x, y, w, h) box (-1 if none). Max index and flags mask are
+// available in tiling_collision_max and tiling_collision_mask
+char tiling_collision(char x, char y, char w, char h)
+{
+    _tiling_scan(_tiling_screen_col(x), _tiling_screen_row(y), _tiling_screen_col(x + w - 1), _tiling_screen_row(y + h - 1));
+    return _tiling_collision_min;
+}
+
+// Returns the OR of the flags of the tiles under the (x, y, w, h) box
+char tiling_collision_flags(char x, char y, char w, char h)
+{
+    _tiling_scan(_tiling_screen_col(x), _tiling_screen_row(y), _tiling_screen_col(x + w - 1), _tiling_screen_row(y + h - 1));
+    return _tiling_collision_mask;
+}
+
+// Returns the tile under the (x, y) point (-1 if outside of the map)
+char tiling_point(char x, char y)
+{
+    _TILING_COORD c = _tiling_screen_col(x);
+    _TILING_COORD r = _tiling_screen_row(y);
+    if (c < 0 || r < 0 || c >= _tiling_width || r >= _tiling_height) return -1;
+#ifdef TILING_STREAMING
+    if (r < _tiling_ypos || r > _tiling_ypos + _MS_NB_SCROLLING_ZONES) return -1;
+#endif
+    return tiling_get_tile(c, r);
+}
+
+// Returns the edges of the (x, y, w, h) box touching a solid tile (TILING_EDGE_* bits), by testing
+// the pixel column or row just outside of each side of the box
+char tiling_collision_edges(char x, char y, char w, char h)
+{
+    _TILING_COORD c0, c1, r0, r1, c, r;
+    char edges = 0, px, py;
+    px = x + _tiling_xoffset;
+    py = y + _tiling_yoffset;
+    c0 = _tiling_screen_col(x);
+    c1 = _tiling_screen_col(x + w - 1);
+    r0 = _tiling_screen_row(y);
+    r1 = _tiling_screen_row(y + h - 1);
+    // Left and right
+    if (px) c = _tiling_xpos + ((px - 1) >> 3); else c = c0 - 1;
+    _tiling_scan(c, r0, c, r1);
+    if (_tiling_collision_mask & TILING_FLAG_SOLID) edges = TILING_EDGE_LEFT;
+    c = _tiling_screen_col(x + w);
+    _tiling_scan(c, r0, c, r1);
+    if (_tiling_collision_mask & TILING_FLAG_SOLID) edges |= TILING_EDGE_RIGHT;
+    // Top and bottom
+    if (py) r = _tiling_ypos + ((py - 1) >> 4); else r = r0 - 1;
+    _tiling_scan(c0, r, c1, r);
+    if (_tiling_collision_mask & TILING_FLAG_SOLID) edges |= TILING_EDGE_TOP;
+    r = _tiling_screen_row(y + h);
+    _tiling_scan(c0, r, c1, r);
+    if (_tiling_collision_mask & TILING_FLAG_SOLID) edges |= TILING_EDGE_BOTTOM;
+    return edges;
+}
+
+
+ramchip char _tiling_sweep_tile;
+
+// Tile hit by the last tiling_sweep: the first solid tile of the column or row entered (-1 if none)
+#define tiling_sweep_tile (_tiling_sweep_tile)
+
+// Swept collision against TILING_FLAG_SOLID tiles, so that fast objects don't tunnel through thin walls:
+// moves the (x, y, w, h) box by (dx, dy) pixels (-127 to 127) and returns the number of steps done before
+// hitting a solid tile (max(|dx|, |dy|) if none). Only the tile column or row entered by the leading edge
+// of the box is tested, each time it crosses a tile boundary
+char tiling_sweep(char x, char y, char w, char h, signed char dx, signed char dy)
+{
+    char adx, ady, l, d, ex, ey, lx, ly;
+    signed char sx, sy;
+    _TILING_COORD c, r;
+    if (dx < 0) { adx = -dx; sx = -1; lx = x; } else { adx = dx; sx = 1; lx = x + w - 1; }
+    if (dy < 0) { ady = -dy; sy = -1; ly = y; } else { ady = dy; sy = 1; ly = y + h - 1; }
+    l = (adx > ady)?adx:ady;
+    ex = l >> 1;
+    ey = ex;
+    _tiling_sweep_tile = -1;
+    for (d = 0; d != l; d++) {
+        ex += adx;
+        if (ex >= l) {
+            ex -= l;
+            c = _tiling_screen_col(lx);
+            x += sx;
+            lx += sx;
+            if (_tiling_screen_col(lx) != c) {
+                c = _tiling_screen_col(lx);
+                _tiling_scan(c, _tiling_screen_row(y), c, _tiling_screen_row(y + h - 1));
+                if (_tiling_collision_mask & TILING_FLAG_SOLID) break;
+            }
+        }
+        ey += ady;
+        if (ey >= l) {
+            ey -= l;
+            r = _tiling_screen_row(ly);
+            y += sy;
+            ly += sy;
+            if (_tiling_screen_row(ly) != r) {
+                r = _tiling_screen_row(ly);
+                _tiling_scan(_tiling_screen_col(x), r, _tiling_screen_col(x + w - 1), r);
+                if (_tiling_collision_mask & TILING_FLAG_SOLID) break;
+            }
+        }
+    }
+    if (d != l) _tiling_sweep_tile = _tiling_collision_solid;
+    return d;
+}
+
+
+// Pixel accurate collision of the (x, y, w, h) box with the tiles, using the tile masks (see multisprite_tile_masks).
+// Returns the first tile hit, or -1 if none. Only the few tiles overlapped by the box are tested
+char tiling_collision_pixel(char x, char y, char w, char h)
+{
+    char mx, my, ex, ey, i, j, l, r, t, b, tile;
+    _TILING_COORD c, rr;
+    mx = x + _tiling_xoffset;
+    my = y + _tiling_yoffset;
+    ex = mx + w - 1;
+    ey = my + h - 1;
+    for (j = my >> 4; j <= (ey >> 4); j++) {
+        rr = _tiling_ypos + j;
+        if (rr >= 0) { // Rows above the map are skipped
+            if (rr >= _tiling_height) break;
+#ifdef TILING_STREAMING
+            if (rr > _tiling_ypos + _MS_NB_SCROLLING_ZONES) break;
+#endif
+            t = (j == (my >> 4))?my & 15:0;
+            b = (j == (ey >> 4))?ey & 15:15;
+            for (i = mx >> 3; i <= (ex >> 3); i++) {
+                c = _tiling_xpos + i;
+                if (c >= 0) { // Columns left of the map too
+                    if (c >= _tiling_width) break;
+                    l = (i == (mx >> 3))?mx & 7:0;
+                    r = (i == (ex >> 3))?ex & 7:7;
+                    tile = tiling_get_tile(c, rr);
+                    if (_ms_tile_mask_box(tile, l, t, r, b)) return tile;
+                }
+            }
+        }
+    }
+    return -1;
+}
+
+#endif